@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "sorting.h"
+
+/*
+   Allocation counters -- interposed malloc --
+
+   The programs define malloc, calloc, realloc and the aligned variants
+   themselves: they count the call and the requested bytes, then forward
+   to the glibc implementation (__libc_*). Since the executable comes
+   first in the symbol lookup, the allocations of the libraries (OpenMP
+   runtime, qsort's temporary buffer, ...) are counted as well. free is
+   not interposed, the counters only go up.
+*/
+
+extern void *__libc_malloc (size_t size) ;
+extern void *__libc_calloc (size_t nmemb, size_t size) ;
+extern void *__libc_realloc (void *p, size_t size) ;
+extern void *__libc_memalign (size_t alignment, size_t size) ;
+
+static uint64_t nb_allocations ;
+static uint64_t nb_bytes ;
+
+
+static inline void count (const size_t size)
+{
+  __atomic_fetch_add (&nb_allocations, 1, __ATOMIC_RELAXED) ;
+  __atomic_fetch_add (&nb_bytes, size, __ATOMIC_RELAXED) ;
+}
+
+void *malloc (size_t size)
+{
+  count (size) ;
+  return __libc_malloc (size) ;
+}
+
+void *calloc (size_t nmemb, size_t size)
+{
+  count (nmemb * size) ;
+  return __libc_calloc (nmemb, size) ;
+}
+
+void *realloc (void *p, size_t size)
+{
+  if (size > 0)
+    count (size) ;
+  return __libc_realloc (p, size) ;
+}
+
+void *memalign (size_t alignment, size_t size)
+{
+  count (size) ;
+  return __libc_memalign (alignment, size) ;
+}
+
+void *aligned_alloc (size_t alignment, size_t size)
+{
+  count (size) ;
+  return __libc_memalign (alignment, size) ;
+}
+
+int posix_memalign (void **p, size_t alignment, size_t size)
+{
+  void *q ;
+
+  if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+    return EINVAL ;
+
+  count (size) ;
+  q = __libc_memalign (alignment, size) ;
+  if (q == NULL)
+    return ENOMEM ;
+
+  *p = q ;
+  return 0 ;
+}
+
+void alloc_counters (uint64_t *allocations, uint64_t *bytes)
+{
+  *allocations = __atomic_load_n (&nb_allocations, __ATOMIC_RELAXED) ;
+  *bytes = __atomic_load_n (&nb_bytes, __ATOMIC_RELAXED) ;
+}
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/mman.h>
+
+#include "sorting.h"
+
+/*
+   Buffer arena used by the benchmarks for the arrays to sort and by
+   merge() for its scratch space.
+
+   Buffers are mmap'ed, aligned on 2 MiB when they are large enough to be
+   backed by transparent huge pages (madvise), or by hugetlbfs pages when
+   ARENA_HUGETLB=1. Released buffers are kept mapped and handed out again
+   to the next request that fits, so repeated experiments on the same size
+   do not pay the page faults again. ARENA_HUGEPAGES=0 keeps 4 KiB pages,
+   to measure the TLB impact. arena_trim() unmaps the released buffers and
+   the per thread scratch buffers, for long running users and between
+   measured variants. Once the slots are all taken buffers are mapped on
+   their own and unmapped by arena_release().
+*/
+
+#define ARENA_MAX_SLOTS   256
+#define SMALL_PAGE        (4096UL)
+#define HUGE_PAGE         (2UL * 1024 * 1024)
+
+typedef struct
+{
+  void *ptr ;
+  size_t bytes ;
+  int in_use ;
+  int scratch ;     /* owned by the scratch of a thread */
+} arena_slot_t ;
+
+/* buffer mapped when the slots are full */
+typedef struct overflow
+{
+  void *ptr ;
+  size_t bytes ;
+  int scratch ;
+  struct overflow *next ;
+} overflow_t ;
+
+static arena_slot_t slots [ARENA_MAX_SLOTS] ;
+static int nb_slots ;
+static overflow_t *overflow ;
+static arena_stats_t stats ;
+
+/* a scratch buffer is only valid in the generation it was allocated in,
+ * arena_trim() starts a new one */
+static uint64_t scratch_generation ;
+static __thread uint64_t *scratch ;
+static __thread uint64_t scratch_count ;
+static __thread uint64_t scratch_seen ;
+
+
+static int env_flag (const char *name, int def)
+{
+  const char *v = getenv (name) ;
+
+  if (v == NULL)
+    return def ;
+  return atoi (v) ;
+}
+
+static void *map_buffer (size_t bytes)
+{
+  uint8_t *p, *aligned ;
+  size_t head, tail ;
+
+  if (bytes < HUGE_PAGE)
+  {
+    p = mmap (NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) ;
+    return (p == MAP_FAILED) ? NULL : p ;
+  }
+
+  if (env_flag ("ARENA_HUGETLB", 0))
+  {
+    p = mmap (NULL, bytes, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0) ;
+    if (p != MAP_FAILED)
+    {
+      stats.huge_bytes += bytes ;
+      return p ;
+    }
+  }
+
+  // Over-allocate by one huge page and trim so the buffer is 2 MiB aligned
+  p = mmap (NULL, bytes + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) ;
+  if (p == MAP_FAILED)
+    return NULL ;
+
+  aligned = (uint8_t *) (((uintptr_t) p + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1)) ;
+  head = aligned - p ;
+  tail = HUGE_PAGE - head ;
+  if (head > 0)
+    munmap (p, head) ;
+  if (tail > 0)
+    munmap (aligned + bytes, tail) ;
+
+  if (env_flag ("ARENA_HUGEPAGES", 1))
+  {
+    if (madvise (aligned, bytes, MADV_HUGEPAGE) == 0)
+      stats.huge_bytes += bytes ;
+  }
+  else
+  {
+    madvise (aligned, bytes, MADV_NOHUGEPAGE) ;
+  }
+
+  return aligned ;
+}
+
+
+static void *alloc_buffer (size_t bytes, const int is_scratch)
+{
+  void *p = NULL ;
+  overflow_t *o ;
+  int best = -1, victim = -1 ;
+  int i ;
+
+  bytes = (bytes < HUGE_PAGE) ? (bytes + SMALL_PAGE - 1) & ~(SMALL_PAGE - 1)
+                              : (bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1) ;
+  if (bytes == 0)
+    bytes = SMALL_PAGE ;
+
+  #pragma omp critical (arena)
+  {
+    // Smallest free buffer that is large enough
+    for (i = 0; i < nb_slots; i++)
+    {
+      if (!slots[i].in_use && slots[i].bytes >= bytes
+          && (best < 0 || slots[i].bytes < slots[best].bytes))
+        best = i ;
+      if (!slots[i].in_use)
+        victim = i ;
+    }
+
+    // All the slots taken: a free buffer too small for the request gives
+    // its slot up
+    if (best < 0 && nb_slots == ARENA_MAX_SLOTS && victim >= 0)
+    {
+      munmap (slots[victim].ptr, slots[victim].bytes) ;
+      nb_slots = nb_slots - 1 ;
+      slots[victim] = slots[nb_slots] ;
+    }
+
+    if (best >= 0)
+    {
+      slots[best].in_use = 1 ;
+      slots[best].scratch = is_scratch ;
+      p = slots[best].ptr ;
+      stats.reuses = stats.reuses + 1 ;
+    }
+    else if (nb_slots < ARENA_MAX_SLOTS)
+    {
+      p = map_buffer (bytes) ;
+      if (p != NULL)
+      {
+        slots[nb_slots].ptr = p ;
+        slots[nb_slots].bytes = bytes ;
+        slots[nb_slots].in_use = 1 ;
+        slots[nb_slots].scratch = is_scratch ;
+        nb_slots = nb_slots + 1 ;
+        stats.mappings = stats.mappings + 1 ;
+        stats.mapped_bytes += bytes ;
+      }
+    }
+    else
+    {
+      o = (overflow_t *) malloc (sizeof(overflow_t)) ;
+      p = (o != NULL) ? map_buffer (bytes) : NULL ;
+      if (p != NULL)
+      {
+        o->ptr = p ;
+        o->bytes = bytes ;
+        o->scratch = is_scratch ;
+        o->next = overflow ;
+        overflow = o ;
+        stats.mappings = stats.mappings + 1 ;
+        stats.mapped_bytes += bytes ;
+      }
+      else
+      {
+        free (o) ;
+      }
+    }
+  }
+
+  if (p == NULL)
+  {
+    fprintf (stderr, "ERROR: arena cannot allocate %zu bytes\n", bytes) ;
+    exit (-1) ;
+  }
+  return p ;
+}
+
+void *arena_alloc (size_t bytes)
+{
+  return alloc_buffer (bytes, 0) ;
+}
+
+void arena_release (void *p)
+{
+  overflow_t **o, *found = NULL ;
+  int i ;
+
+  if (p == NULL)
+    return ;
+
+  #pragma omp critical (arena)
+  {
+    for (i = 0; i < nb_slots; i++)
+    {
+      if (slots[i].ptr == p)
+      {
+        slots[i].in_use = 0 ;
+        break ;
+      }
+    }
+
+    if (i == nb_slots)
+    {
+      for (o = &overflow; *o != NULL; o = &(*o)->next)
+      {
+        if ((*o)->ptr == p)
+        {
+          found = *o ;
+          *o = found->next ;
+          break ;
+        }
+      }
+    }
+  }
+
+  if (found != NULL)
+  {
+    munmap (found->ptr, found->bytes) ;
+    free (found) ;
+  }
+}
+
+uint64_t arena_trim (void)
+{
+  overflow_t **o, *dead ;
+  uint64_t unmapped = 0 ;
+  int i, n = 0 ;
+
+  #pragma omp critical (arena)
+  {
+    for (i = 0; i < nb_slots; i++)
+    {
+      if (!slots[i].in_use || slots[i].scratch)
+      {
+        munmap (slots[i].ptr, slots[i].bytes) ;
+        unmapped += slots[i].bytes ;
+      }
+      else
+      {
+        slots[n++] = slots[i] ;
+      }
+    }
+    nb_slots = n ;
+
+    o = &overflow ;
+    while (*o != NULL)
+    {
+      if ((*o)->scratch)
+      {
+        dead = *o ;
+        *o = dead->next ;
+        munmap (dead->ptr, dead->bytes) ;
+        unmapped += dead->bytes ;
+        free (dead) ;
+      }
+      else
+      {
+        o = &(*o)->next ;
+      }
+    }
+    scratch_generation = scratch_generation + 1 ;
+  }
+
+  return unmapped ;
+}
+
+void arena_destroy (void)
+{
+  overflow_t *o ;
+  int i ;
+
+  #pragma omp critical (arena)
+  {
+    for (i = 0; i < nb_slots; i++)
+    {
+      munmap (slots[i].ptr, slots[i].bytes) ;
+    }
+    nb_slots = 0 ;
+
+    while (overflow != NULL)
+    {
+      o = overflow ;
+      overflow = o->next ;
+      munmap (o->ptr, o->bytes) ;
+      free (o) ;
+    }
+    scratch_generation = scratch_generation + 1 ;
+  }
+}
+
+uint64_t *arena_scratch (uint64_t count)
+{
+  /* per thread buffer, only grows until the next arena_trim(), never
+     shared between threads */
+  if (scratch_seen != __atomic_load_n (&scratch_generation, __ATOMIC_ACQUIRE))
+  {
+    // Unmapped by arena_trim()
+    scratch = NULL ;
+    scratch_count = 0 ;
+    scratch_seen = __atomic_load_n (&scratch_generation, __ATOMIC_ACQUIRE) ;
+  }
+
+  if (count > scratch_count)
+  {
+    arena_release (scratch) ;
+    scratch_count = (count > 2 * scratch_count) ? count : 2 * scratch_count ;
+    scratch = (uint64_t *) alloc_buffer (scratch_count * sizeof(uint64_t), 1) ;
+  }
+  return scratch ;
+}
+
+arena_stats_t arena_stats (void)
+{
+  arena_stats_t s ;
+
+  #pragma omp critical (arena)
+  s = stats ;
+
+  return s ;
+}
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <x86intrin.h>
+
+#include "sorting.h"
+
+/*
+   asynchronous sorts -- submit now, wait later --
+
+   sort_submit() queues the request and returns at once; a background
+   thread, started by the first submission, runs the queued sorts one
+   after the other in submission order (each one still uses all the
+   OpenMP threads), so the caller can prepare the next array or check
+   the previous one meanwhile. The handle is a future: sort_done() polls
+   it, sort_wait() blocks until the array is sorted and frees it.
+*/
+
+struct sort_handle
+{
+  sort_t sort ;
+  uint64_t *T ;
+  uint64_t size ;
+  uint64_t cycles ;
+  int done ;
+  struct sort_handle *next ;
+} ;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER ;
+static pthread_cond_t queued = PTHREAD_COND_INITIALIZER ;
+static pthread_cond_t finished = PTHREAD_COND_INITIALIZER ;
+static sort_handle_t *head, *tail ;
+static int worker_started ;
+
+
+static void *worker (void *arg)
+{
+  sort_handle_t *h ;
+  uint64_t start ;
+
+  (void) arg ;
+  for (;;)
+  {
+    pthread_mutex_lock (&lock) ;
+    while (head == NULL)
+      pthread_cond_wait (&queued, &lock) ;
+    h = head ;
+    head = h->next ;
+    if (head == NULL)
+      tail = NULL ;
+    pthread_mutex_unlock (&lock) ;
+
+    start = _rdtsc () ;
+    h->sort (h->T, h->size) ;
+    h->cycles = _rdtsc () - start ;
+
+    pthread_mutex_lock (&lock) ;
+    h->done = 1 ;
+    pthread_cond_broadcast (&finished) ;
+    pthread_mutex_unlock (&lock) ;
+  }
+  return NULL ;
+}
+
+sort_handle_t *sort_submit (sort_t sort, uint64_t *T, const uint64_t size)
+{
+  sort_handle_t *h = (sort_handle_t *) malloc (sizeof(sort_handle_t)) ;
+  pthread_t thread ;
+
+  h->sort = sort ;
+  h->T = T ;
+  h->size = size ;
+  h->cycles = 0 ;
+  h->done = 0 ;
+  h->next = NULL ;
+
+  pthread_mutex_lock (&lock) ;
+  if (! worker_started)
+  {
+    if (pthread_create (&thread, NULL, worker, NULL) != 0)
+    {
+      fprintf (stderr, "ERROR: cannot start the sort thread\n") ;
+      exit (-1) ;
+    }
+    pthread_detach (thread) ;
+    worker_started = 1 ;
+  }
+
+  if (tail == NULL)
+    head = h ;
+  else
+    tail->next = h ;
+  tail = h ;
+  pthread_cond_signal (&queued) ;
+  pthread_mutex_unlock (&lock) ;
+
+  return h ;
+}
+
+int sort_done (sort_handle_t *h)
+{
+  int done ;
+
+  pthread_mutex_lock (&lock) ;
+  done = h->done ;
+  pthread_mutex_unlock (&lock) ;
+
+  return done ;
+}
+
+uint64_t sort_wait (sort_handle_t *h)
+{
+  uint64_t cycles ;
+
+  pthread_mutex_lock (&lock) ;
+  while (! h->done)
+    pthread_cond_wait (&finished, &lock) ;
+  pthread_mutex_unlock (&lock) ;
+
+  cycles = h->cycles ;
+  free (h) ;
+  return cycles ;
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   autotune -- chooses the cutoffs of the tuning profile on this machine --
+
+   Each parameter is benchmarked in turn on random arrays of size 2^N,
+   keeping the best value found for the previous ones:
+   1. leaf_size with sequential_merge_sort
+   2. task_cutoff with parallel_merge_sort
+   3. chunks_per_thread with parallel_quicksort
+   4. sequential_cutoff: the smallest power of two for which
+      parallel_quicksort beats sequential_quicksort
+   The result is written to the profile file (SORT_PROFILE or
+   sort_profile.txt) that every program loads at startup.
+*/
+
+static const uint64_t leaf_sizes [] = { 2, 4, 8, 16, 32, 64, 128 } ;
+static const uint64_t task_cutoffs [] = { 1 << 8, 1 << 10, 1 << 12, 1 << 14, 1 << 16, 1 << 18 } ;
+static const uint64_t chunks_per_thread [] = { 1, 2, 4, 8, 16 } ;
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+
+static void merge_sort_in_region (uint64_t *T, const uint64_t size)
+{
+  #pragma omp parallel
+  {
+    #pragma omp single
+    parallel_merge_sort (T, size) ;
+  }
+}
+
+static void copy_input (uint64_t *T, const uint64_t size, const unsigned int exp, const void *R)
+{
+  memcpy (T, R, size * sizeof(uint64_t)) ;
+}
+
+static double measure (sort_t sort, uint64_t *X, uint64_t *R, const uint64_t size)
+{
+  /* average Mcycles of sort over NBEXPERIMENTS copies of the same input R */
+  return (double)time_sort_experiments ("tuning", sort, X, size, copy_input, R)/1000000 ;
+}
+
+static uint64_t tune (const char *name, uint64_t *parameter, const uint64_t *candidates, const unsigned int count,
+                      sort_t sort, uint64_t *X, uint64_t *R, const uint64_t size)
+{
+  double best = 0, t ;
+  uint64_t best_value = *parameter ;
+  unsigned int i ;
+
+  printf ("\n %s\n", name) ;
+  for (i = 0; i < count; i++)
+  {
+    if (candidates[i] > size)
+      break ;
+    *parameter = candidates[i] ;
+    t = measure (sort, X, R, size) ;
+    printf ("   %10lu \t%.2lf Mcycles\n", candidates[i], t) ;
+    if (i == 0 || t < best)
+    {
+      best = t ;
+      best_value = candidates[i] ;
+    }
+  }
+  *parameter = best_value ;
+  printf ("   --> %lu\n", best_value) ;
+  return best_value ;
+}
+
+int main (int argc, char **argv)
+{
+  uint64_t size ;
+  double serial, parallel ;
+
+  printf("================================================\n");
+  printf(" Max number of threads: %d \n", omp_get_max_threads());
+
+  /* the program takes one parameter N, the size 2^N of the arrays used
+     to tune the cutoffs */
+  if (argc != 2)
+  {
+      fprintf (stderr, "autotune.run N \n") ;
+      exit (-1) ;
+  }
+
+  uint64_t N = 1UL << (atoi(argv[1])) ;
+  uint64_t *X = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+  uint64_t *R = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+
+  printf(" --> Tuning on random arrays of size %lu (2^%u)\n", N, atoi(argv[1]));
+
+  init_array_random (R, N) ;
+
+  // Everything parallel while tuning the grain
+  tuning.sequential_cutoff = 1 ;
+
+  tune ("leaf_size (sequential_merge_sort)", &tuning.leaf_size, leaf_sizes, COUNT(leaf_sizes),
+        sequential_merge_sort, X, R, N) ;
+  tune ("task_cutoff (parallel_merge_sort)", &tuning.task_cutoff, task_cutoffs, COUNT(task_cutoffs),
+        merge_sort_in_region, X, R, N) ;
+  tune ("chunks_per_thread (parallel_quicksort)", &tuning.chunks_per_thread, chunks_per_thread,
+        COUNT(chunks_per_thread), parallel_quicksort, X, R, N) ;
+
+  // Smallest size where the parallel version wins
+  printf ("\n sequential_cutoff (sequential vs parallel_quicksort)\n") ;
+  tuning.sequential_cutoff = N ;
+  for (size = 2; size <= N; size *= 2)
+  {
+    uint64_t cutoff = tuning.sequential_cutoff ;
+
+    serial = measure (sequential_quicksort, X, R, size) ;
+    tuning.sequential_cutoff = 1 ;
+    parallel = measure (parallel_quicksort, X, R, size) ;
+    tuning.sequential_cutoff = cutoff ;
+    printf ("   %10lu \t%.3lf / %.3lf Mcycles\n", size, serial, parallel) ;
+    if (parallel < serial)
+    {
+      tuning.sequential_cutoff = size / 2 ;
+      break ;
+    }
+  }
+  printf ("   --> %lu\n", tuning.sequential_cutoff) ;
+
+  if (tuning_save (tuning_profile_path ()) != 0)
+  {
+      fprintf (stderr, "ERROR: cannot write %s\n", tuning_profile_path ()) ;
+      exit (-1) ;
+  }
+  printf ("\n Profile written to %s\n", tuning_profile_path ()) ;
+
+  arena_release (X) ;
+  arena_release (R) ;
+
+  printf("================================================\n\n");
+}
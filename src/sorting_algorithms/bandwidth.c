@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <x86intrin.h>
+
+#include "sorting.h"
+
+/*
+   Memory bandwidth -- stream-style roofline for the sorts --
+
+   Three kernels over arrays much larger than the caches: read (sum),
+   write (fill) and copy, each run by a given number of threads on
+   static chunks. The copy bandwidth counts the bytes read plus the
+   bytes written, like the traffic models of the sorts, and the best one
+   over the repetitions with all the threads is the peak the sorts are
+   compared to.
+
+   The traffic models count the bytes one pass over the array moves to
+   and from memory:
+   - merge pass (merge_pair): the two runs are merged into the scratch
+     buffer and copied back, each key is read twice and written twice
+   - quicksort partition level: each key is read and written once
+   Once the recursion reaches blocks whose working set fits in the
+   thread's share of the last level cache, the levels below cost a
+   single pass (each key read and written once) instead of one each.
+*/
+
+/* keys per stream array: 128 MiB, far beyond the last level cache */
+#define STREAM_SIZE (1UL << 24)
+#define STREAM_REPEAT 5
+
+/* bytes moved per key by one merge pass and one partition level */
+#define MERGE_PASS_KEY_BYTES (4 * sizeof(uint64_t))
+#define PARTITION_PASS_KEY_BYTES (2 * sizeof(uint64_t))
+
+/* used when sysconf does not know the cache sizes */
+#define DEFAULT_CACHE_SIZE (8UL << 20)
+
+static double tsc_hz ;
+static double peak ;
+
+/* keeps the read kernel from being optimized away */
+static volatile uint64_t sink ;
+
+
+double tsc_frequency (void)
+{
+  /* rdtsc ticks per second, calibrated once against the monotonic clock */
+  struct timespec t0, t1 ;
+  uint64_t c0, c1 ;
+
+  if (tsc_hz > 0)
+    return tsc_hz ;
+
+  clock_gettime (CLOCK_MONOTONIC, &t0) ;
+  c0 = _rdtsc () ;
+  do
+  {
+    clock_gettime (CLOCK_MONOTONIC, &t1) ;
+  } while ((t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec) < 50000000L) ;
+  c1 = _rdtsc () ;
+
+  tsc_hz = (double)(c1 - c0) / ((t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9) ;
+  return tsc_hz ;
+}
+
+static double gb_per_s (const uint64_t bytes, const uint64_t cycles)
+{
+  return (double)bytes / ((double)cycles / tsc_frequency ()) / 1e9 ;
+}
+
+void measure_bandwidth (bandwidth_t *b, const int nb_threads)
+{
+  /* not from the arena: it would keep them resident after the
+     measurement */
+  uint64_t *A = (uint64_t *) malloc (STREAM_SIZE * sizeof(uint64_t)) ;
+  uint64_t *B = (uint64_t *) malloc (STREAM_SIZE * sizeof(uint64_t)) ;
+  uint64_t start, end, best_read = UINT64_MAX, best_write = UINT64_MAX, best_copy = UINT64_MAX ;
+  uint64_t sum = 0 ;
+  uint64_t i ;
+  int r ;
+
+  // First touch by the threads that stream them afterwards
+  #pragma omp parallel for schedule(static) num_threads(nb_threads)
+  for (i = 0; i < STREAM_SIZE; i++)
+  {
+    A[i] = i ;
+    B[i] = 0 ;
+  }
+
+  for (r = 0; r < STREAM_REPEAT; r++)
+  {
+    start = _rdtsc () ;
+    #pragma omp parallel for simd schedule(static) num_threads(nb_threads) reduction(+:sum)
+    for (i = 0; i < STREAM_SIZE; i++)
+    {
+      sum += A[i] ;
+    }
+    end = _rdtsc () ;
+    if (end - start < best_read)
+      best_read = end - start ;
+
+    start = _rdtsc () ;
+    #pragma omp parallel for simd schedule(static) num_threads(nb_threads)
+    for (i = 0; i < STREAM_SIZE; i++)
+    {
+      B[i] = r ;
+    }
+    end = _rdtsc () ;
+    if (end - start < best_write)
+      best_write = end - start ;
+
+    start = _rdtsc () ;
+    #pragma omp parallel for simd schedule(static) num_threads(nb_threads)
+    for (i = 0; i < STREAM_SIZE; i++)
+    {
+      B[i] = A[i] ;
+    }
+    end = _rdtsc () ;
+    if (end - start < best_copy)
+      best_copy = end - start ;
+  }
+  sink = sum + B[STREAM_SIZE - 1] ;
+
+  b->read = gb_per_s (STREAM_SIZE * sizeof(uint64_t), best_read) ;
+  b->write = gb_per_s (STREAM_SIZE * sizeof(uint64_t), best_write) ;
+  b->copy = gb_per_s (2 * STREAM_SIZE * sizeof(uint64_t), best_copy) ;
+
+  free (A) ;
+  free (B) ;
+}
+
+double peak_bandwidth (void)
+{
+  /* copy bandwidth with all the threads, measured at the first call */
+  bandwidth_t b ;
+
+  if (peak > 0)
+    return peak ;
+
+  measure_bandwidth (&b, omp_get_max_threads ()) ;
+  peak = b.copy ;
+  return peak ;
+}
+
+static uint64_t cache_share (const uint64_t nb_threads)
+{
+  /* bytes of last level cache per thread */
+  long llc = sysconf (_SC_LEVEL3_CACHE_SIZE) ;
+
+  if (llc <= 0)
+    llc = sysconf (_SC_LEVEL2_CACHE_SIZE) ;
+  if (llc <= 0)
+    llc = DEFAULT_CACHE_SIZE ;
+
+  return (uint64_t) llc / ((nb_threads == 0) ? 1 : nb_threads) ;
+}
+
+uint64_t merge_sort_traffic (const uint64_t size, const uint64_t nb_threads, uint64_t *passes)
+{
+  /* one merge pass per level above the blocks that fit in the cache
+     with their scratch buffer, and one pass for these blocks */
+  const uint64_t cache = cache_share (nb_threads) ;
+  uint64_t levels = 0 ;
+  uint64_t s ;
+
+  for (s = size; s > tuning.leaf_size && 2 * s * sizeof(uint64_t) > cache; s = (s + 1) / 2)
+    levels++ ;
+
+  *passes = levels + 1 ;
+  return size * (levels * MERGE_PASS_KEY_BYTES + PARTITION_PASS_KEY_BYTES) ;
+}
+
+uint64_t quicksort_traffic (const uint64_t size, const uint64_t nb_chunks, uint64_t *passes)
+{
+  /* partition levels inside each chunk until the partitions fit in the
+     cache, then one merge pass per level of the chunk merge tree */
+  const uint64_t chunks = (nb_chunks == 0) ? 1 : nb_chunks ;
+  const uint64_t max_threads = (uint64_t) omp_get_max_threads () ;
+  const uint64_t threads = (chunks < max_threads) ? chunks : max_threads ;
+  const uint64_t cache = cache_share (threads) ;
+  uint64_t partition = 0 ;
+  uint64_t merges = 0 ;
+  uint64_t s ;
+
+  for (s = size / chunks; s > 1 && s * sizeof(uint64_t) > cache; s = s / 2)
+    partition++ ;
+  for (s = 1; s < chunks; s += s)
+    merges++ ;
+
+  *passes = partition + 1 + merges ;
+  return size * ((partition + 1) * PARTITION_PASS_KEY_BYTES + merges * MERGE_PASS_KEY_BYTES) ;
+}
+
+void print_bandwidth (const char *label, const uint64_t bytes, const uint64_t passes, const uint64_t cycles)
+{
+  double achieved = gb_per_s (bytes, cycles) ;
+  double best = peak_bandwidth () ;
+
+  printf (" %s traffic \t%lu memory passes, %.2lf MiB per pass\n", label, passes,
+          (passes == 0) ? 0.0 : (double)bytes / passes / (1024*1024)) ;
+  printf (" %s bandwidth \t%.2lf GB/s (%.1lf%% of the %.2lf GB/s copy peak)\n\n",
+          label, achieved, 100.0 * achieved / best, best) ;
+}
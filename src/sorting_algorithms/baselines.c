@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "sorting.h"
+
+/*
+   reference baselines -- what the libraries already do --
+
+   The speedups of the benchmarks are against their own sequential
+   version, which says little when that version is slow (bubble sort).
+   report_baselines() times glibc qsort, std::sort, std::stable_sort and
+   std::sort(std::execution::par) (when built with the parallel STL) on
+   arrays from the same initialization, then gives the speedup of every
+   variant of the benchmark against the fastest serial baseline: what
+   adopting it would gain over the library sort.
+*/
+
+typedef struct
+{
+  const char *name ;
+  sort_t sort ;
+  int parallel ;
+} baseline_t ;
+
+static const baseline_t baselines [] =
+{
+  { "glibc qsort",              sequential_quicksort, 0 },
+  { "std::sort",                std_sort,             0 },
+  { "std::stable_sort",         std_stable_sort,      0 },
+  { "std::sort(par)",           std_parallel_sort,    1 },
+} ;
+
+#define NB_BASELINES (sizeof(baselines) / sizeof(baselines[0]))
+
+
+void report_baselines (init_t init, const void *arg, const uint64_t size,
+                       const char **labels, const double *cycles, const int nb_variants)
+{
+  uint64_t *T = (uint64_t *) arena_alloc (size * sizeof(uint64_t)) ;
+  double baseline_cycles [NB_BASELINES] ;
+  unsigned int b ;
+  int best = -1, v ;
+
+  printf ("\n Reference baselines (same input):\n") ;
+  for (b = 0; b < NB_BASELINES; b++)
+  {
+    if (baselines[b].parallel && ! std_parallel_sort_available ())
+    {
+      printf (" %-24s not built (no parallel STL)\n", baselines[b].name) ;
+      baseline_cycles[b] = 0 ;
+      continue ;
+    }
+
+    baseline_cycles[b] = (double)time_sort_experiments (baselines[b].name, baselines[b].sort,
+                                                        T, size, init, arg)/1000000 ;
+    printf (" %-24s %10.2lf Mcycles\n", baselines[b].name, baseline_cycles[b]) ;
+
+    if (! baselines[b].parallel && (best < 0 || baseline_cycles[b] < baseline_cycles[best]))
+      best = b ;
+  }
+
+  printf ("\n Speedup vs %s (fastest serial baseline):\n", baselines[best].name) ;
+  for (v = 0; v < nb_variants; v++)
+  {
+    printf (" %-24s %10f\n", labels[v], baseline_cycles[best] / cycles[v]) ;
+  }
+  for (b = 0; b < NB_BASELINES; b++)
+  {
+    if ((int) b != best && baseline_cycles[b] > 0)
+      printf (" %-24s %10f\n", baselines[b].name, baseline_cycles[best] / baseline_cycles[b]) ;
+  }
+
+  arena_release (T) ;
+}
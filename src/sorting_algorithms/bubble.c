@@ -1,10 +1,9 @@
 #include <stdio.h>
 #include <omp.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
-#include <x86intrin.h>
-
 #include "sorting.h"
 
 /* 
@@ -70,6 +69,13 @@ void parallel_bubble_sort (uint64_t *T, const uint64_t size)
     uint64_t temp, sorted, i;
     uint64_t ch_sz, ret_val;
     
+    // Small arrays (tuning.sequential_cutoff) are not worth waking the threads
+    if (size <= tuning.sequential_cutoff)
+    {
+        sequential_bubble_sort(T, size);
+        return;
+    }
+
     ch_sz = size / omp_get_max_threads();  
     do
     {
@@ -113,12 +119,12 @@ void parallel_bubble_sort (uint64_t *T, const uint64_t size)
 
 int main (int argc, char **argv)
 {
-    uint64_t start, end;
     uint64_t av ;
-    unsigned int exp ;
+    mem_counters_t counters ;
 
     printf("================================================\n");
     printf(" Max number of threads: %d \n", omp_get_max_threads());
+    print_tuning () ;
 
     /* the program takes one parameter N which is the size of the array to
        be sorted. The array will have size 2^N */
@@ -130,7 +136,7 @@ int main (int argc, char **argv)
 
     uint64_t N = 1 << (atoi(argv[1])) ;
     /* the array to be sorted */
-    uint64_t *X = (uint64_t *) malloc (N * sizeof(uint64_t)) ;
+    uint64_t *X = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
 
     printf(" --> Sorting an array of size %lu\n",N);
     #ifdef RINIT
@@ -138,88 +144,36 @@ int main (int argc, char **argv)
     #endif
     
 
-    for (exp = 0 ; exp < NBEXPERIMENTS; exp++)
-    {
-        #ifdef RINIT
-            init_array_random (X, N);
-        #else
-            init_array_sequence (X, N);
-        #endif
-        
-        start = _rdtsc () ;
-        
-        sequential_bubble_sort (X, N) ;
-     
-        end = _rdtsc () ;
-        experiments [exp] = end - start ;
-
-        /* verifying that X is properly sorted */
-        #ifdef RINIT
-        if (! is_sorted (X, N))
-        {
-            fprintf(stderr, "ERROR: the sequential sorting of the array failed\n") ;
-            print_array (X, N) ;
-            exit (-1) ;
-	    }
-        #else
-        if (! is_sorted_sequence (X, N))
-        {
-            fprintf(stderr, "ERROR: the sequential sorting of the array failed\n") ;
-            print_array (X, N) ;
-            exit (-1) ;
-	    }
-        #endif
-    }
-
-    av = average_time() ;  
+    mem_counters_start (&counters) ;
+    av = time_sort_experiments ("bubble serial", sequential_bubble_sort, X, N, init_array_benchmark, NULL) ;
+    mem_counters_stop (&counters) ;
 
     double serial_cycles = (double)av/1000000;
     printf ("\n bubble serial \t\t%.2lf Mcycles\n\n", serial_cycles) ;
+    print_mem_counters ("serial", &counters) ;
+    write_mem_counters_csv ("bubble", "serial", N, av, &counters) ;
 
   
-    for (exp = 0 ; exp < NBEXPERIMENTS; exp++)
-    {
-        #ifdef RINIT
-            init_array_random (X, N);
-        #else
-            init_array_sequence (X, N);
-        #endif
-        
-        start = _rdtsc () ;
-
-        parallel_bubble_sort (X, N) ;
-     
-        end = _rdtsc () ;
-        experiments [exp] = end - start ;
+    mem_counters_start (&counters) ;
+    av = time_sort_experiments ("bubble parallel", parallel_bubble_sort, X, N, init_array_benchmark, NULL) ;
+    mem_counters_stop (&counters) ;
 
-        /* verifying that X is properly sorted */
-        #ifdef RINIT
-            if (! is_sorted (X, N))
-            {
-                fprintf(stderr, "ERROR: the parallel sorting of the array failed\n") ;
-                exit (-1) ;
-            }
-        #else
-            if (! is_sorted_sequence (X, N))
-            {
-                fprintf(stderr, "ERROR: the parallel sorting of the array failed\n") ;
-                print_array (X, N) ;
-                exit (-1) ;
-            }
-        #endif
-                  
-    }
-    
-    av = average_time() ;  
     double parallel_cycles = (double)av/1000000;
     printf (" bubble parallel \t%.2lf Mcycles\n\n", parallel_cycles) ;
+    print_mem_counters ("parallel", &counters) ;
+    write_mem_counters_csv ("bubble", "parallel", N, av, &counters) ;
   
     printf(" Speedup: \t\t%f\n", serial_cycles/parallel_cycles);
+
+    const char *variants [] = { "bubble serial", "bubble parallel" } ;
+    double variant_cycles [] = { serial_cycles, parallel_cycles } ;
+    report_baselines (init_array_benchmark, NULL, N, variants, variant_cycles, 2) ;
+
     /* print_array (X, N) ; */
 
     /* before terminating, we run one extra test of the algorithm */
-    uint64_t *Y = (uint64_t *) malloc (N * sizeof(uint64_t)) ;
-    uint64_t *Z = (uint64_t *) malloc (N * sizeof(uint64_t)) ;
+    uint64_t *Y = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+    uint64_t *Z = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
 
     #ifdef RINIT
         init_array_random (Y, N);
@@ -238,9 +192,9 @@ int main (int argc, char **argv)
     }
 
 
-    free(X);
-    free(Y);
-    free(Z);
+    arena_release(X);
+    arena_release(Y);
+    arena_release(Z);
 
     printf("================================================\n\n");
     
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "sorting.h"
+
+/*
+   Benchmark of the compressed key paths: keys spread over 2^bits values
+   above a large base, sorted as 64 bit keys and through their offsets.
+   The compressed entries say which path ran: counting sort, 32 bit
+   offsets or the 64 bit sort when the range (or KEY_COMPRESSION=0) does
+   not allow it.
+*/
+
+#define KEY_BASE (1ULL << 40)
+
+static void init_array_bits (uint64_t *T, const uint64_t size, const unsigned int bits, uint64_t seed)
+{
+  const uint64_t mask = (bits >= 64) ? UINT64_MAX : (1ULL << bits) - 1 ;
+  uint64_t i ;
+
+  for (i = 0; i < size; i++)
+  {
+    seed ^= seed << 13 ;
+    seed ^= seed >> 7 ;
+    seed ^= seed << 17 ;
+    T[i] = (bits >= 64) ? seed : KEY_BASE + (seed & mask) ;
+  }
+}
+
+/* bits of the offsets the last compressed sort used, 0 for 64 bit keys */
+static int compressed_bits ;
+
+static void merge_sort_in_region (uint64_t *T, const uint64_t size)
+{
+  #pragma omp parallel
+  {
+    #pragma omp single
+    parallel_merge_sort (T, size) ;
+  }
+}
+
+static void quicksort_compressed (uint64_t *T, const uint64_t size)
+{
+  compressed_bits = compressed_quicksort (T, size) ;
+  if (! compressed_bits)
+    parallel_quicksort (T, size) ;
+}
+
+static void merge_sort_compressed (uint64_t *T, const uint64_t size)
+{
+  compressed_bits = compressed_merge_sort (T, size) ;
+  if (! compressed_bits)
+    merge_sort_in_region (T, size) ;
+}
+
+static const char *compressed_path (void)
+{
+  if (compressed_bits == 16)
+    return "counting sort" ;
+  if (compressed_bits == 32)
+    return "32 bit offsets" ;
+  return "64 bit keys" ;
+}
+
+static void init_experiment (uint64_t *T, const uint64_t size, const unsigned int exp, const void *bits)
+{
+  init_array_bits (T, size, *(const unsigned int *) bits, 0x9e3779b97f4a7c15ULL + exp) ;
+}
+
+int main (int argc, char **argv)
+{
+  uint64_t min, max ;
+
+  printf("================================================\n");
+  printf(" Max number of threads: %d \n", omp_get_max_threads());
+  print_tuning () ;
+  printf(" Merge kernel: %s \n", merge_kernel_name());
+
+  /* the program takes two parameters: N, the array has size 2^N, and the
+     number of bits of the key range */
+  if (argc != 3 || atoi (argv[2]) < 1 || atoi (argv[2]) > 64)
+  {
+      fprintf (stderr, "compress.run N bits (1..64) \n") ;
+      exit (-1) ;
+  }
+
+  uint64_t N = 1UL << (atoi(argv[1])) ;
+  unsigned int bits = atoi (argv[2]) ;
+  uint64_t *X = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+
+  init_array_bits (X, N, bits, 0x9e3779b97f4a7c15ULL) ;
+  parallel_key_range (X, N, &min, &max) ;
+
+  printf(" --> Sorting an array of size %lu (2^%u), keys over 2^%u values\n", N, atoi(argv[1]), bits);
+  printf(" --> Offsets from the smallest key need %d bits\n\n", key_range_bits (min, max));
+
+  double quick_64 = run_sort_experiments ("parallel_quicksort", parallel_quicksort, X, N, init_experiment, &bits) ;
+  double quick_compressed = run_sort_experiments ("compressed_quicksort", quicksort_compressed, X, N, init_experiment, &bits) ;
+  printf ("   (ran as %s)\n", compressed_path ()) ;
+  double merge_64 = run_sort_experiments ("parallel_merge_sort", merge_sort_in_region, X, N, init_experiment, &bits) ;
+  double merge_compressed = run_sort_experiments ("compressed_merge_sort", merge_sort_compressed, X, N, init_experiment, &bits) ;
+  printf ("   (ran as %s)\n", compressed_path ()) ;
+
+  printf ("\n Speedup of the compressed quicksort \t%f\n", quick_64/quick_compressed) ;
+  printf (" Speedup of the compressed merge sort \t%f\n", merge_64/merge_compressed) ;
+
+  arena_release (X) ;
+
+  printf("================================================\n\n");
+}
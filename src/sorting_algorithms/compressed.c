@@ -0,0 +1,479 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <immintrin.h>
+
+#include "sorting.h"
+
+/*
+   compressed keys -- sorting offsets from the smallest key --
+
+   The kernels move 64 bit keys even when every key fits in far fewer
+   bits, as with init_array_sequence or rand(). A parallel pass finds the
+   smallest and the largest key; when max - min fits in 32 bits, the
+   offsets T[i] - min are packed in a uint32_t array, sorted there (half
+   the memory traffic, 16 keys per AVX-512 merge step instead of 8) and
+   expanded back into T. When it fits in 16 bits there is nothing left to
+   compare: a counting sort over the 65536 possible offsets writes T
+   directly. compressed_quicksort() and compressed_merge_sort() follow the
+   structure of parallel_quicksort and parallel_merge_sort, which stay
+   64 bit sorts: callers choose the compressed path explicitly, and the
+   result tells which one ran.
+*/
+
+/* below this many keys per thread a 16 bit range is still sorted in 32
+   bit lanes: every thread clears 2^16 counters and they are folded
+   serially, which would cost more than the keys */
+#define COUNTING_KEYS_PER_THREAD (1 << 16)
+
+#define RANGE_16 ((uint64_t) UINT16_MAX)
+#define RANGE_32 ((uint64_t) UINT32_MAX)
+
+typedef void (*merge32_kernel_t) (uint32_t *, const uint32_t *, uint64_t,
+                                  const uint32_t *, uint64_t) ;
+
+int key_compression = 1 ;
+static merge32_kernel_t merge32_kernel ;
+
+
+/* ------------------------------------------------ 32 bit merge kernels */
+
+static void merge32_scalar (uint32_t *dst, const uint32_t *A, uint64_t na,
+                            const uint32_t *B, uint64_t nb)
+{
+  uint64_t i = 0, j = 0, k = 0 ;
+  uint32_t a, b ;
+  uint64_t take_b ;
+
+  while ((i < na) && (j < nb))
+  {
+    a = A [i] ;
+    b = B [j] ;
+    take_b = b < a ;
+    dst [k] = take_b ? b : a ;
+    i = i + 1 - take_b ;
+    j = j + take_b ;
+    k = k + 1 ;
+  }
+
+  memcpy (dst + k, A + i, (na - i) * sizeof(uint32_t)) ;
+  k = k + na - i ;
+  memcpy (dst + k, B + j, (nb - j) * sizeof(uint32_t)) ;
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i bitonic_clean32_avx512 (__m512i v)
+{
+  /* sort a bitonic sequence of 16: half cleaners at distance 8, 4, 2, 1 */
+  const __m512i d8 = _mm512_set_epi32 (7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8) ;
+  const __m512i d4 = _mm512_set_epi32 (11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4) ;
+  const __m512i d2 = _mm512_set_epi32 (13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2) ;
+  const __m512i d1 = _mm512_set_epi32 (14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1) ;
+  __m512i t ;
+
+  t = _mm512_permutexvar_epi32 (d8, v) ;
+  v = _mm512_mask_blend_epi32 (0xFF00, _mm512_min_epu32 (v, t), _mm512_max_epu32 (v, t)) ;
+  t = _mm512_permutexvar_epi32 (d4, v) ;
+  v = _mm512_mask_blend_epi32 (0xF0F0, _mm512_min_epu32 (v, t), _mm512_max_epu32 (v, t)) ;
+  t = _mm512_permutexvar_epi32 (d2, v) ;
+  v = _mm512_mask_blend_epi32 (0xCCCC, _mm512_min_epu32 (v, t), _mm512_max_epu32 (v, t)) ;
+  t = _mm512_permutexvar_epi32 (d1, v) ;
+  v = _mm512_mask_blend_epi32 (0xAAAA, _mm512_min_epu32 (v, t), _mm512_max_epu32 (v, t)) ;
+
+  return v ;
+}
+
+__attribute__((target("avx512f")))
+static void merge32_avx512 (uint32_t *dst, const uint32_t *A, uint64_t na,
+                            const uint32_t *B, uint64_t nb)
+{
+  const __m512i rev = _mm512_set_epi32 (0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15) ;
+  uint32_t carry [16], tmp [64] ;
+  uint64_t i, j, k ;
+  __m512i va, vb, r, mn, mx ;
+
+  if (na < 16 || nb < 16)
+  {
+    merge32_scalar (dst, A, na, B, nb) ;
+    return ;
+  }
+
+  va = _mm512_loadu_si512 ((const void *) A) ;
+  vb = _mm512_loadu_si512 ((const void *) B) ;
+  i = 16 ;
+  j = 16 ;
+  k = 0 ;
+
+  for (;;)
+  {
+    // va = 16 smallest, vb = 16 largest, both sorted
+    r = _mm512_permutexvar_epi32 (rev, vb) ;
+    mn = _mm512_min_epu32 (va, r) ;
+    mx = _mm512_max_epu32 (va, r) ;
+    va = bitonic_clean32_avx512 (mn) ;
+    vb = bitonic_clean32_avx512 (mx) ;
+
+    _mm512_storeu_si512 ((void *) (dst + k), va) ;
+    k = k + 16 ;
+
+    if (i + 16 > na || j + 16 > nb)
+      break ;
+
+    // Refill from the run whose next element is the smallest
+    if (A [i] <= B [j])
+    {
+      va = _mm512_loadu_si512 ((const void *) (A + i)) ;
+      i = i + 16 ;
+    }
+    else
+    {
+      va = _mm512_loadu_si512 ((const void *) (B + j)) ;
+      j = j + 16 ;
+    }
+  }
+
+  // vb holds the 16 largest keys consumed, one run has less than 16 left
+  _mm512_storeu_si512 ((void *) carry, vb) ;
+  if (na - i < 16)
+  {
+    merge32_scalar (tmp, carry, 16, A + i, na - i) ;
+    merge32_scalar (dst + k, tmp, 16 + na - i, B + j, nb - j) ;
+  }
+  else
+  {
+    merge32_scalar (tmp, carry, 16, B + j, nb - j) ;
+    merge32_scalar (dst + k, tmp, 16 + nb - j, A + i, na - i) ;
+  }
+}
+
+__attribute__((constructor))
+static void select_merge32_kernel (void)
+{
+  /* same choice as the 64 bit kernel, MERGE_KERNEL included, whose
+     warnings merge.c already gives (there is no AVX2 version: 8 lanes of
+     32 bits do not pay for the shuffles, avx2 runs the scalar one) */
+  static const merge32_kernel_t kernels [] = { merge32_scalar, merge32_scalar, merge32_avx512 } ;
+  const char *compression = getenv ("KEY_COMPRESSION") ;
+  kernel_choice_t choices [3] ;
+
+  __builtin_cpu_init () ;
+
+  choices[0] = (kernel_choice_t) { "scalar", 1 } ;
+  choices[1] = (kernel_choice_t) { "avx2", __builtin_cpu_supports ("avx2") } ;
+  choices[2] = (kernel_choice_t) { "avx512", __builtin_cpu_supports ("avx512f") } ;
+
+  merge32_kernel = kernels[select_kernel ("MERGE_KERNEL", choices, 3, 0)] ;
+
+  if (compression != NULL && strcmp (compression, "0") == 0)
+    key_compression = 0 ;
+}
+
+static void merge_pair32 (uint32_t *T, const uint64_t n1, const uint64_t n2)
+{
+  uint32_t *X = (uint32_t *) arena_scratch ((n1 + n2 + 1) / 2) ;
+
+  merge32_kernel (X, T, n1, T + n1, n2) ;
+
+  memcpy (T, X, (n1 + n2) * sizeof(uint32_t)) ;
+}
+
+/* ------------------------------------------------ 32 bit sorts */
+
+static void insertion_sort32 (uint32_t *T, const uint64_t size)
+{
+  uint64_t i, j ;
+  uint32_t temp ;
+
+  for (i = 1; i < size; i++)
+  {
+    temp = T[i] ;
+    for (j = i; j > 0 && T[j-1] > temp; j--)
+    {
+      T[j] = T[j-1] ;
+    }
+    T[j] = temp ;
+  }
+}
+
+static void sequential_quicksort32 (uint32_t *T, uint64_t size)
+{
+  /* the comparisons inlined, where qsort would call a comparator for
+     each of them: median of three pivot, Hoare partition */
+  uint64_t i, j ;
+  uint32_t a, b, c, pivot, temp ;
+
+  // Recursion on the smaller side, loop on the larger: O(log n) stack
+  while (size > tuning.leaf_size)
+  {
+    a = T[0] ;
+    b = T[size/2] ;
+    c = T[size-1] ;
+    pivot = (a < b) ? ((b < c) ? b : (a < c) ? c : a)
+                    : ((a < c) ? a : (b < c) ? c : b) ;
+
+    i = 0 ;
+    j = size - 1 ;
+    for (;;)
+    {
+      while (T[i] < pivot) i++ ;
+      while (T[j] > pivot) j-- ;
+      if (i >= j)
+        break ;
+      temp = T[i] ;
+      T[i] = T[j] ;
+      T[j] = temp ;
+      i++ ;
+      j-- ;
+    }
+
+    // T[0..j] <= pivot <= T[j+1..size)
+    if (j + 1 < size - j - 1)
+    {
+      sequential_quicksort32 (T, j + 1) ;
+      T = T + j + 1 ;
+      size = size - j - 1 ;
+    }
+    else
+    {
+      sequential_quicksort32 (T + j + 1, size - j - 1) ;
+      size = j + 1 ;
+    }
+  }
+  insertion_sort32 (T, size) ;
+}
+
+static void sequential_merge_sort32 (uint32_t *T, const uint64_t size)
+{
+  if (size <= tuning.leaf_size)
+  {
+    insertion_sort32 (T, size) ;
+    return ;
+  }
+
+  sequential_merge_sort32 (T, size/2) ;
+  sequential_merge_sort32 (T + size/2, size - size/2) ;
+  merge_pair32 (T, size/2, size - size/2) ;
+}
+
+static void parallel_merge_sort32 (uint32_t *T, const uint64_t size)
+{
+  if (size <= tuning.task_cutoff)
+  {
+    sequential_merge_sort32 (T, size) ;
+    return ;
+  }
+
+  #pragma omp task
+  parallel_merge_sort32 (T, size/2) ;
+  #pragma omp task
+  parallel_merge_sort32 (T + size/2, size - size/2) ;
+
+  #pragma omp taskwait
+  merge_pair32 (T, size/2, size - size/2) ;
+}
+
+static void parallel_quicksort32 (uint32_t *T, const uint64_t size)
+{
+  /* same structure as parallel_quicksort: chunk sorts, then merges that
+     only wait for their two runs */
+  const uint64_t nb_chunks = omp_get_max_threads () * tuning.chunks_per_thread ;
+  char *ready ;
+  uint64_t c, width, lo, mid, hi ;
+
+  if (size <= tuning.sequential_cutoff)
+  {
+    sequential_quicksort32 (T, size) ;
+    return ;
+  }
+
+  ready = (char *) malloc (nb_chunks) ;
+
+  #pragma omp parallel
+  #pragma omp single
+  {
+    for (c = 0; c < nb_chunks; c++)
+    {
+      #pragma omp task depend(out: ready[c]) firstprivate(c) private(lo, hi)
+      {
+        lo = c*size/nb_chunks ;
+        hi = (c+1)*size/nb_chunks ;
+        sequential_quicksort32 (T + lo, hi - lo) ;
+      }
+    }
+
+    for (width = 1; width < nb_chunks; width += width)
+    {
+      for (c = 0; c + width < nb_chunks; c += 2*width)
+      {
+        #pragma omp task depend(inout: ready[c]) depend(in: ready[c+width]) \
+                         firstprivate(c, width) private(lo, mid, hi)
+        {
+          lo = c*size/nb_chunks ;
+          mid = (c+width)*size/nb_chunks ;
+          hi = ((c+2*width < nb_chunks) ? c+2*width : nb_chunks)*size/nb_chunks ;
+          merge_pair32 (T + lo, mid - lo, hi - mid) ;
+        }
+      }
+    }
+  }
+
+  free (ready) ;
+}
+
+/* ------------------------------------------------ 16 bit ranges */
+
+static void counting_sort16 (uint64_t *T, const uint64_t size, const uint64_t min)
+{
+  /* every offset T[i] - min is below 2^16: count them per thread, then
+     each thread writes its part of T as runs of equal keys */
+  const int nth = omp_get_max_threads () ;
+  const uint64_t nb_values = RANGE_16 + 1 ;
+  uint64_t *counts = (uint64_t *) calloc ((uint64_t) nth * nb_values, sizeof(uint64_t)) ;
+  uint64_t *offsets = (uint64_t *) malloc ((nb_values + 1) * sizeof(uint64_t)) ;
+  uint64_t v ;
+  int t ;
+
+  #pragma omp parallel num_threads(nth)
+  {
+    uint64_t *local = counts + (uint64_t) omp_get_thread_num () * nb_values ;
+    uint64_t i ;
+
+    #pragma omp for schedule(static)
+    for (i = 0; i < size; i++)
+    {
+      local[T[i] - min] += 1 ;
+    }
+  }
+
+  offsets[0] = 0 ;
+  for (v = 0; v < nb_values; v++)
+  {
+    for (t = 1; t < nth; t++)
+    {
+      counts[v] += counts[(uint64_t) t * nb_values + v] ;
+    }
+    offsets[v+1] = offsets[v] + counts[v] ;
+  }
+
+  #pragma omp parallel num_threads(nth)
+  {
+    int tid = omp_get_thread_num () ;
+    int team = omp_get_num_threads () ;
+    uint64_t lo = size * tid / team ;
+    uint64_t hi = size * (tid + 1) / team ;
+    uint64_t first = 0, last = nb_values, m, k, j, end ;
+
+    // Last value starting at or before lo
+    while (last - first > 1)
+    {
+      m = (first + last) / 2 ;
+      if (offsets[m] <= lo)
+        first = m ;
+      else
+        last = m ;
+    }
+
+    for (k = first, j = lo; j < hi; k++)
+    {
+      end = (offsets[k+1] < hi) ? offsets[k+1] : hi ;
+      for (; j < end; j++)
+      {
+        T[j] = min + k ;
+      }
+    }
+  }
+
+  free (offsets) ;
+  free (counts) ;
+}
+
+/* ------------------------------------------------ public entry points */
+
+void parallel_key_range (const uint64_t *T, const uint64_t size, uint64_t *min, uint64_t *max)
+{
+  uint64_t lo = UINT64_MAX, hi = 0 ;
+  uint64_t i ;
+
+  #pragma omp parallel for schedule(static) reduction(min: lo) reduction(max: hi) \
+                           if (size > tuning.sequential_cutoff)
+  for (i = 0; i < size; i++)
+  {
+    lo = (T[i] < lo) ? T[i] : lo ;
+    hi = (T[i] > hi) ? T[i] : hi ;
+  }
+
+  *min = lo ;
+  *max = hi ;
+}
+
+int key_range_bits (const uint64_t min, const uint64_t max)
+{
+  if (max - min <= RANGE_16)
+    return 16 ;
+  if (max - min <= RANGE_32)
+    return 32 ;
+  return 64 ;
+}
+
+static int compressed_sort (uint64_t *T, const uint64_t size, const int merge_sort)
+{
+  uint64_t min, max, i ;
+  uint32_t *P ;
+  int bits ;
+
+  if (! key_compression || size == 0)
+    return 0 ;
+
+  parallel_key_range (T, size, &min, &max) ;
+  bits = key_range_bits (min, max) ;
+
+  if (bits == 64)
+    return 0 ;
+
+  if (bits == 16 && size >= (uint64_t) omp_get_max_threads () * COUNTING_KEYS_PER_THREAD)
+  {
+    counting_sort16 (T, size, min) ;
+    return 16 ;
+  }
+
+  P = (uint32_t *) arena_alloc (size * sizeof(uint32_t)) ;
+
+  #pragma omp parallel for schedule(static) if (size > tuning.sequential_cutoff)
+  for (i = 0; i < size; i++)
+  {
+    P[i] = (uint32_t) (T[i] - min) ;
+  }
+
+  if (merge_sort)
+  {
+    #pragma omp parallel if (size > tuning.sequential_cutoff)
+    #pragma omp single
+    parallel_merge_sort32 (P, size) ;
+  }
+  else
+  {
+    parallel_quicksort32 (P, size) ;
+  }
+
+  #pragma omp parallel for schedule(static) if (size > tuning.sequential_cutoff)
+  for (i = 0; i < size; i++)
+  {
+    T[i] = min + P[i] ;
+  }
+
+  arena_release (P) ;
+  return 32 ;
+}
+
+int compressed_quicksort (uint64_t *T, const uint64_t size)
+{
+  return compressed_sort (T, size, 0) ;
+}
+
+int compressed_merge_sort (uint64_t *T, const uint64_t size)
+{
+  return compressed_sort (T, size, 1) ;
+}
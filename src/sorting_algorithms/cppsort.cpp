@@ -0,0 +1,167 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include <omp.h>
+
+#include "sorting.hpp"
+
+/*
+   Benchmark of the C++ front-end (sorting.hpp) on records sorted by
+   one of their members, against qsort with a void* comparator, which is
+   what sorting them with the C interface costs.
+
+   Odd-even transposition is quadratic, it only runs up to 2^ODDEVEN_MAX_LOG.
+*/
+
+#define ODDEVEN_MAX_LOG 14
+
+struct record
+{
+  uint64_t key ;
+  uint32_t id ;
+} ;
+
+/* a function object rather than a function pointer, so its call is
+   inlined in the sorts */
+struct by_key
+{
+  bool operator() (const record &a, const record &b) const
+  {
+    return a.key < b.key ;
+  }
+} ;
+
+static int compare_records (const void *x, const void *y)
+{
+  const record *a = (const record *) x ;
+  const record *b = (const record *) y ;
+
+  return (a->key > b->key) - (a->key < b->key) ;
+}
+
+
+/* the experiment of run: sort the records R made from the keys K */
+template <class Sort>
+struct records_experiment
+{
+  Sort sort ;
+  std::vector<record> &R ;
+  std::vector<uint64_t> &K ;
+
+  static void prepare (void *arg, const unsigned int exp)
+  {
+    records_experiment *e = (records_experiment *) arg ;
+    const uint64_t N = e->R.size () ;
+
+    init_array_benchmark (e->K.data (), N, exp, NULL) ;
+    for (uint64_t i = 0; i < N; i++)
+    {
+      e->R[i].key = e->K[i] ;
+      e->R[i].id = (uint32_t) i ;
+    }
+  }
+
+  static void run (void *arg)
+  {
+    records_experiment *e = (records_experiment *) arg ;
+
+    e->sort (e->R) ;
+  }
+
+  static const char *verify (void *arg, const unsigned int exp)
+  {
+    /* the order, and that the records are a permutation of the input:
+       every id is seen once and still carries its key */
+    records_experiment *e = (records_experiment *) arg ;
+    const std::vector<record> &R = e->R ;
+    const uint64_t N = R.size () ;
+    std::vector<bool> seen (N) ;
+
+    for (uint64_t i = 0; i < N; i++)
+    {
+      if ((i > 0 && R[i].key < R[i-1].key) || R[i].id >= N || seen[R[i].id] || e->K[R[i].id] != R[i].key)
+        return "failed" ;
+      seen[R[i].id] = true ;
+    }
+    return NULL ;
+  }
+} ;
+
+template <class Sort>
+static double run (const char *label, Sort sort, std::vector<record> &R, std::vector<uint64_t> &K)
+{
+  records_experiment<Sort> r = { sort, R, K } ;
+  experiment_t e = { &r, records_experiment<Sort>::prepare, records_experiment<Sort>::run,
+                     records_experiment<Sort>::verify } ;
+
+  double cycles = (double)time_experiments (label, &e)/1000000 ;
+  printf (" %-36s %10.2lf Mcycles\n", label, cycles) ;
+  return cycles ;
+}
+
+static double run_keys (const char *label, sort_t sort, std::vector<uint64_t> &K)
+{
+  double cycles = (double)time_sort_experiments (label, sort, K.data (), K.size (),
+                                                 init_array_benchmark, NULL)/1000000 ;
+  printf (" %-36s %10.2lf Mcycles\n", label, cycles) ;
+  return cycles ;
+}
+
+int main (int argc, char **argv)
+{
+  printf("================================================\n");
+  printf(" Max number of threads: %d \n", omp_get_max_threads());
+  print_tuning () ;
+
+  /* the program takes one parameter N, the number of records is 2^N */
+  if (argc != 2)
+  {
+      fprintf (stderr, "cppsort.run N \n") ;
+      exit (-1) ;
+  }
+
+  uint64_t N = 1UL << (atoi(argv[1])) ;
+  std::vector<record> R (N) ;
+  std::vector<uint64_t> K (N) ;
+
+  printf(" --> Sorting %lu records of %zu bytes (2^%u)\n", N, sizeof(record), atoi(argv[1]));
+  #ifdef RINIT
+    printf("--> The array is initialized randomly\n");
+  #endif
+  printf("\n");
+
+  double qsort_cycles = run ("qsort (void* comparator)", [] (std::vector<record> &V) {
+      qsort (V.data (), V.size (), sizeof(record), compare_records) ; }, R, K) ;
+
+  double seq_quick_cycles = run ("pap::quicksort (seq)", [] (std::vector<record> &V) {
+      pap::quicksort (pap::execution::seq, V.begin (), V.end (), by_key ()) ; }, R, K) ;
+  double par_quick_cycles = run ("pap::quicksort (par)", [] (std::vector<record> &V) {
+      pap::quicksort (pap::execution::par, V.begin (), V.end (), by_key ()) ; }, R, K) ;
+  double seq_merge_cycles = run ("pap::merge_sort (seq)", [] (std::vector<record> &V) {
+      pap::merge_sort (pap::execution::seq, V.begin (), V.end (), by_key ()) ; }, R, K) ;
+  double par_merge_cycles = run ("pap::merge_sort (par)", [] (std::vector<record> &V) {
+      pap::merge_sort (pap::execution::par, V.begin (), V.end (), by_key ()) ; }, R, K) ;
+
+  if (atoi(argv[1]) <= ODDEVEN_MAX_LOG)
+  {
+    run ("pap::oddeven_sort (par)", [] (std::vector<record> &V) {
+        pap::oddeven_sort (pap::execution::par, V.begin (), V.end (),
+                           [] (const record &a, const record &b) { return a.key < b.key ; }) ; }, R, K) ;
+  }
+
+  // uint64_t with the default comparator goes to the C kernels
+  printf ("\n") ;
+  run_keys ("pap::quicksort (par, uint64_t)", [] (uint64_t *T, const uint64_t size) {
+      pap::quicksort (pap::execution::par, T, T + size) ; }, K) ;
+  run_keys ("pap::merge_sort (par, uint64_t)", [] (uint64_t *T, const uint64_t size) {
+      pap::merge_sort (pap::execution::par, T, T + size) ; }, K) ;
+
+  printf ("\n Speedup of pap::quicksort (seq) vs qsort \t%f\n", qsort_cycles/seq_quick_cycles) ;
+  printf (" Speedup of pap::quicksort (par) vs qsort \t%f\n", qsort_cycles/par_quick_cycles) ;
+  printf (" Speedup of pap::merge_sort (seq) vs qsort \t%f\n", qsort_cycles/seq_merge_cycles) ;
+  printf (" Speedup of pap::merge_sort (par) vs qsort \t%f\n", qsort_cycles/par_merge_cycles) ;
+
+  printf("================================================\n\n");
+}
@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   duplicate-heavy inputs -- three-way quicksort, histogram sort --
+
+   With few distinct keys a comparison sort keeps comparing keys that
+   are equal. Two kernels use it instead:
+   - three-way quicksort: each partition puts the keys equal to the pivot
+     in the middle, where they are final, so a key value is never looked
+     at again once it has been a pivot: O(n log d) for d distinct keys
+   - histogram sort: every thread counts its chunk in a small hash table,
+     the tables are merged, the d distinct keys are sorted and T is
+     rewritten as runs of equal keys: O(n + d log d), but only for up to
+     HISTOGRAM_MAX_KEYS distinct keys
+   duplicate_aware_sort() samples the array to estimate d and picks one
+   of them, or none when the keys are mostly distinct. parallel_quicksort
+   calls it first. histogram_count() stops at the sorted histogram, for
+   the fused sort-unique and sort-count (unique.c).
+*/
+
+/* most distinct keys the histogram sort handles (hash table per thread
+   of twice as many slots) */
+#define HISTOGRAM_MAX_KEYS (1 << 15)
+#define HISTOGRAM_SLOTS (2 * HISTOGRAM_MAX_KEYS)
+
+/* keys sampled to estimate the number of distinct keys */
+#define DISTINCT_SAMPLE 4096
+
+/* the three-way quicksort is used when the keys appear at least this many
+   times each on average */
+#define MIN_COPIES_PER_KEY 16
+
+typedef struct
+{
+  uint64_t key ;
+  uint64_t count ;   /* 0: empty slot */
+} bucket_t ;
+
+
+static uint64_t median_of_three (uint64_t a, uint64_t b, uint64_t c)
+{
+  if (a > b) { uint64_t t = a; a = b; b = t; }
+  if (b > c) { b = c; }
+  return (a > b) ? a : b ;
+}
+
+static void partition_3way (uint64_t *T, const uint64_t size, uint64_t *lt, uint64_t *gt)
+{
+  /* Dijkstra's partition: T[0..lt) < pivot, T[lt..gt) == pivot,
+     T[gt..size) > pivot */
+  const uint64_t pivot = median_of_three (T[0], T[size / 2], T[size - 1]) ;
+  uint64_t l = 0, i = 0, g = size ;
+  uint64_t temp ;
+
+  while (i < g)
+  {
+    if (T[i] < pivot)
+    {
+      temp = T[l] ; T[l] = T[i] ; T[i] = temp ;
+      l = l + 1 ;
+      i = i + 1 ;
+    }
+    else if (T[i] > pivot)
+    {
+      g = g - 1 ;
+      temp = T[g] ; T[g] = T[i] ; T[i] = temp ;
+    }
+    else
+    {
+      i = i + 1 ;
+    }
+  }
+
+  *lt = l ;
+  *gt = g ;
+}
+
+void sequential_quicksort_3way (uint64_t *T, uint64_t size)
+{
+  uint64_t lt, gt ;
+
+  // Recursion on the smaller side, loop on the larger: O(log n) stack
+  while (size > tuning.leaf_size)
+  {
+    partition_3way (T, size, &lt, &gt) ;
+
+    if (lt < size - gt)
+    {
+      sequential_quicksort_3way (T, lt) ;
+      T = T + gt ;
+      size = size - gt ;
+    }
+    else
+    {
+      sequential_quicksort_3way (T + gt, size - gt) ;
+      size = lt ;
+    }
+  }
+  insertion_sort (T, size) ;
+}
+
+static void quicksort_3way_tasks (uint64_t *T, const uint64_t size)
+{
+  uint64_t lt, gt ;
+
+  if (size <= tuning.task_cutoff)
+  {
+    sequential_quicksort_3way (T, size) ;
+    return ;
+  }
+
+  partition_3way (T, size, &lt, &gt) ;
+
+  #pragma omp task
+  quicksort_3way_tasks (T, lt) ;
+  quicksort_3way_tasks (T + gt, size - gt) ;
+  #pragma omp taskwait
+}
+
+void parallel_quicksort_3way (uint64_t *T, const uint64_t size)
+{
+  if (size <= tuning.sequential_cutoff)
+  {
+    sequential_quicksort_3way (T, size) ;
+    return ;
+  }
+
+  #pragma omp parallel
+  {
+    #pragma omp single
+    quicksort_3way_tasks (T, size) ;
+  }
+}
+
+static inline uint64_t hash (uint64_t key)
+{
+  /* murmur3 finalizer */
+  key ^= key >> 33 ;
+  key *= 0xff51afd7ed558ccdULL ;
+  key ^= key >> 33 ;
+  key *= 0xc4ceb9fe1a85ec53ULL ;
+  key ^= key >> 33 ;
+  return key ;
+}
+
+static int count_key (bucket_t *table, const uint64_t key, const uint64_t n, uint64_t *distinct)
+{
+  /* adds n copies of key to table, 0 when the table is full */
+  uint64_t s = hash (key) & (HISTOGRAM_SLOTS - 1) ;
+
+  while (table[s].count != 0 && table[s].key != key)
+  {
+    s = (s + 1) & (HISTOGRAM_SLOTS - 1) ;
+  }
+
+  if (table[s].count == 0)
+  {
+    if (*distinct == HISTOGRAM_MAX_KEYS)
+      return 0 ;
+    *distinct = *distinct + 1 ;
+    table[s].key = key ;
+  }
+  table[s].count += n ;
+  return 1 ;
+}
+
+static int compare_buckets (const void *x, const void *y)
+{
+  const bucket_t *a = (const bucket_t *) x ;
+  const bucket_t *b = (const bucket_t *) y ;
+
+  return (a->key > b->key) - (a->key < b->key) ;
+}
+
+static bucket_t *sorted_histogram (const uint64_t *T, const uint64_t size, bucket_t **keys, uint64_t *distinct)
+{
+  /* *keys[0..*distinct) gets the keys of T in order with their counts;
+     returns the block to arena_release, NULL when there are too many
+     keys. The tables (1 MiB per thread) come from the arena, which
+     keeps them mapped from one call to the next */
+  int nth = omp_get_max_threads () ;
+  bucket_t *tables = (bucket_t *) arena_alloc ((uint64_t) (nth + 1) * HISTOGRAM_SLOTS * sizeof(bucket_t)) ;
+  bucket_t *merged = tables + (uint64_t) nth * HISTOGRAM_SLOTS ;
+  uint64_t i, s ;
+  int overflow = 0 ;
+  int t ;
+
+  memset (merged, 0, HISTOGRAM_SLOTS * sizeof(bucket_t)) ;
+
+  // Per thread histograms, stopping as soon as one table is full
+  #pragma omp parallel num_threads(nth)
+  {
+    int tid = omp_get_thread_num () ;
+    int team = omp_get_num_threads () ;
+    bucket_t *table = tables + (uint64_t) tid * HISTOGRAM_SLOTS ;
+    uint64_t lo = size * tid / team ;
+    uint64_t hi = size * (tid + 1) / team ;
+    uint64_t local = 0 ;
+    uint64_t j ;
+    int c ;
+
+    // A reused buffer is not zero, and the team may be smaller than nth
+    for (c = tid; c < nth; c += team)
+    {
+      memset (tables + (uint64_t) c * HISTOGRAM_SLOTS, 0, HISTOGRAM_SLOTS * sizeof(bucket_t)) ;
+    }
+
+    for (j = lo; j < hi; j++)
+    {
+      if (! count_key (table, T[j], 1, &local)
+          || ((j & 4095) == 0 && __atomic_load_n (&overflow, __ATOMIC_RELAXED)))
+      {
+        __atomic_store_n (&overflow, 1, __ATOMIC_RELAXED) ;
+        break ;
+      }
+    }
+  }
+
+  // Merged histogram, then its keys in order
+  *distinct = 0 ;
+  for (t = 0; t < nth && ! overflow; t++)
+  {
+    for (s = 0; s < HISTOGRAM_SLOTS; s++)
+    {
+      if (tables[(uint64_t) t * HISTOGRAM_SLOTS + s].count != 0
+          && ! count_key (merged, tables[(uint64_t) t * HISTOGRAM_SLOTS + s].key,
+                          tables[(uint64_t) t * HISTOGRAM_SLOTS + s].count, distinct))
+      {
+        overflow = 1 ;
+        break ;
+      }
+    }
+  }
+
+  if (overflow)
+  {
+    arena_release (tables) ;
+    return NULL ;
+  }
+
+  for (s = 0, i = 0; s < HISTOGRAM_SLOTS; s++)
+  {
+    if (merged[s].count != 0)
+      merged[i++] = merged[s] ;
+  }
+  qsort (merged, *distinct, sizeof(bucket_t), compare_buckets) ;
+
+  *keys = merged ;
+  return tables ;
+}
+
+int histogram_sort (uint64_t *T, const uint64_t size)
+{
+  int nth = omp_get_max_threads () ;
+  bucket_t *merged ;
+  bucket_t *tables ;
+  uint64_t *offsets ;
+  uint64_t distinct ;
+  uint64_t i ;
+
+  tables = sorted_histogram (T, size, &merged, &distinct) ;
+  if (tables == NULL)
+    return 0 ;
+
+  offsets = (uint64_t *) arena_alloc ((distinct + 1) * sizeof(uint64_t)) ;
+  offsets[0] = 0 ;
+  for (i = 0; i < distinct; i++)
+  {
+    offsets[i+1] = offsets[i] + merged[i].count ;
+  }
+
+  // Each thread rewrites its part of T: first key by binary search, then runs
+  #pragma omp parallel num_threads(nth)
+  {
+    int tid = omp_get_thread_num () ;
+    int team = omp_get_num_threads () ;
+    uint64_t lo = size * tid / team ;
+    uint64_t hi = size * (tid + 1) / team ;
+    uint64_t first = 0, last = distinct, mid, k, j, end ;
+
+    while (last - first > 1)
+    {
+      mid = (first + last) / 2 ;
+      if (offsets[mid] <= lo)
+        first = mid ;
+      else
+        last = mid ;
+    }
+
+    for (k = first, j = lo; j < hi; k++)
+    {
+      end = (offsets[k+1] < hi) ? offsets[k+1] : hi ;
+      for (; j < end; j++)
+      {
+        T[j] = merged[k].key ;
+      }
+    }
+  }
+
+  arena_release (offsets) ;
+  arena_release (tables) ;
+  return 1 ;
+}
+
+static uint64_t estimate_distinct (const uint64_t *T, const uint64_t size)
+{
+  /* number of distinct keys from a random sample, Chao1 estimator: the
+     d keys seen plus f1^2 / 2 f2 unseen ones, from the f1 keys seen once
+     and the f2 seen twice (bias corrected form, defined for f2 = 0). It
+     is a lower bound, close when the keys have similar frequencies, and
+     the choice only needs to know whether d is small next to size */
+  uint64_t sample [DISTINCT_SAMPLE] ;
+  uint64_t s = (size / 16 < DISTINCT_SAMPLE) ? size / 16 : DISTINCT_SAMPLE ;
+  uint64_t state = 0x9e3779b97f4a7c15ULL ^ size ;
+  uint64_t i, run, d, f1, f2, estimate ;
+
+  if (s < 2)
+    return size ;
+
+  for (i = 0; i < s; i++)
+  {
+    state ^= state << 13 ;
+    state ^= state >> 7 ;
+    state ^= state << 17 ;
+    sample[i] = T[state % size] ;
+  }
+  small_array_sort (sample, s) ;
+
+  for (i = 1, run = 1, d = 0, f1 = 0, f2 = 0; i <= s; i++)
+  {
+    if (i < s && sample[i] == sample[i-1])
+    {
+      run = run + 1 ;
+      continue ;
+    }
+    d = d + 1 ;
+    f1 += run == 1 ;
+    f2 += run == 2 ;
+    run = 1 ;
+  }
+
+  if (d == s)
+    return size ;
+
+  estimate = d + f1 * (f1 - 1) / (2 * (f2 + 1)) ;
+  return (estimate < size) ? estimate : size ;
+}
+
+int duplicate_aware_sort (uint64_t *T, const uint64_t size)
+{
+  uint64_t distinct = estimate_distinct (T, size) ;
+
+  if (distinct <= HISTOGRAM_MAX_KEYS && histogram_sort (T, size))
+    return 1 ;
+
+  if (distinct * MIN_COPIES_PER_KEY <= size)
+  {
+    parallel_quicksort_3way (T, size) ;
+    return 1 ;
+  }
+
+  return 0 ;
+}
+
+uint64_t histogram_count (uint64_t *T, const uint64_t size, uint64_t *counts)
+{
+  bucket_t *merged, *tables ;
+  uint64_t distinct, i ;
+
+  if (estimate_distinct (T, size) > HISTOGRAM_MAX_KEYS)
+    return 0 ;
+
+  tables = sorted_histogram (T, size, &merged, &distinct) ;
+  if (tables == NULL)
+    return 0 ;
+
+  for (i = 0; i < distinct; i++)
+  {
+    T[i] = merged[i].key ;
+    if (counts != NULL)
+      counts[i] = merged[i].count ;
+  }
+
+  arena_release (tables) ;
+  return distinct ;
+}
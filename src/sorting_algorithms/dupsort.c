@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   Benchmark of the duplicate-aware kernels on arrays with a given number
+   of distinct keys, spread over the whole 64 bit range.
+*/
+
+static void merge_sort_in_region (uint64_t *T, const uint64_t size)
+{
+  #pragma omp parallel
+  {
+    #pragma omp single
+    parallel_merge_sort (T, size) ;
+  }
+}
+
+static void histogram_or_fail (uint64_t *T, const uint64_t size)
+{
+  if (! histogram_sort (T, size))
+  {
+    fprintf (stderr, "ERROR: too many distinct keys for histogram_sort\n") ;
+    exit (-1) ;
+  }
+}
+
+static void init_array_distinct (uint64_t *T, const uint64_t size, const uint64_t distinct)
+{
+  uint64_t i, z ;
+
+  for (i = 0; i < size; i++)
+  {
+    /* splitmix64 of the key index, so the keys are not small integers */
+    z = (uint64_t) (rand () % distinct) + 0x9e3779b97f4a7c15ULL ;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL ;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL ;
+    T[i] = z ^ (z >> 31) ;
+  }
+}
+
+static void init_experiment (uint64_t *T, const uint64_t size, const unsigned int exp, const void *distinct)
+{
+  srand (exp) ;
+  init_array_distinct (T, size, *(const uint64_t *) distinct) ;
+}
+
+int main (int argc, char **argv)
+{
+  printf("================================================\n");
+  printf(" Max number of threads: %d \n", omp_get_max_threads());
+  print_tuning () ;
+
+  /* the program takes two parameters: N, the array has size 2^N, and the
+     number of distinct keys */
+  if (argc != 3 || strtoul (argv[2], NULL, 10) == 0)
+  {
+      fprintf (stderr, "dupsort.run N distinct \n") ;
+      exit (-1) ;
+  }
+
+  uint64_t N = 1UL << (atoi(argv[1])) ;
+  uint64_t distinct = strtoul (argv[2], NULL, 10) ;
+  uint64_t *X = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+
+  printf(" --> Sorting an array of size %lu (2^%u) with %lu distinct keys\n\n", N, atoi(argv[1]), distinct);
+
+  double qsort_cycles = run_sort_experiments ("sequential_quicksort (qsort)", sequential_quicksort, X, N, init_experiment, &distinct) ;
+  run_sort_experiments ("parallel_merge_sort", merge_sort_in_region, X, N, init_experiment, &distinct) ;
+  run_sort_experiments ("sequential_quicksort_3way", sequential_quicksort_3way, X, N, init_experiment, &distinct) ;
+  double three_way_cycles = run_sort_experiments ("parallel_quicksort_3way", parallel_quicksort_3way, X, N, init_experiment, &distinct) ;
+  double auto_cycles = run_sort_experiments ("parallel_quicksort (sampled)", parallel_quicksort, X, N, init_experiment, &distinct) ;
+
+  printf ("\n Speedup of parallel_quicksort_3way vs qsort \t%f\n", qsort_cycles/three_way_cycles) ;
+  printf (" Speedup of parallel_quicksort vs qsort \t%f\n", qsort_cycles/auto_cycles) ;
+
+  // The histogram only exists for few distinct keys
+  init_array_distinct (X, N, distinct) ;
+  if (histogram_sort (X, N))
+  {
+    double histogram_cycles = run_sort_experiments ("histogram_sort", histogram_or_fail, X, N, init_experiment, &distinct) ;
+    printf (" Speedup of histogram_sort vs qsort \t\t%f\n", qsort_cycles/histogram_cycles) ;
+  }
+  else
+  {
+    printf (" histogram_sort: more distinct keys than its table holds\n") ;
+  }
+
+  arena_release (X) ;
+
+  printf("================================================\n\n");
+}
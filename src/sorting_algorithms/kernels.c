@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   Sorting kernels shared by the benchmarks: quicksort.c and mergesort.c
+   time them, the other programs (segmented sort, ...) call them as
+   baselines or building blocks.
+*/
+
+int compare_function(const void *x, const void *y)
+{
+  /* Compare function for qsort() */
+
+  // Not the difference: it does not fit in an int for large keys
+  uint64_t a = *(uint64_t*)x;
+  uint64_t b = *(uint64_t*)y;
+
+  return (a > b) - (a < b);
+}
+
+// ------------------------------------------------
+
+/* 
+   quick sort -- sequential, parallel -- 
+*/
+
+void sequential_quicksort(uint64_t *T, const uint64_t size)
+{
+  // Just calls the built-in qsort function
+  qsort(T, size, sizeof(uint64_t), compare_function);
+  return;
+}
+
+void parallel_quicksort(uint64_t *T, const uint64_t size)
+{
+  uint64_t nb_chunks, width, lo, mid, hi;
+  uint64_t c;
+
+  // Small arrays (tuning.sequential_cutoff) are not worth waking the threads
+  if (size <= tuning.sequential_cutoff)
+  {
+    sequential_quicksort(T, size);
+    return;
+  }
+
+  // Few distinct keys (sampled): three-way quicksort or histogram sort
+  if (duplicate_aware_sort(T, size))
+    return;
+
+  // tuning.chunks_per_thread chunks per thread, chunk c is
+  // T[c*size/nb_chunks..(c+1)*size/nb_chunks) so any size works
+  nb_chunks = omp_get_max_threads() * tuning.chunks_per_thread;
+
+  // ready[c] stands for the run starting at chunk c: a merge depends on
+  // its two runs only, so it starts as soon as they are sorted instead of
+  // waiting for the whole level (no barrier between levels)
+  char *ready = (char *) malloc(nb_chunks);
+
+  #pragma omp parallel
+  #pragma omp single
+  {
+    for (c = 0; c < nb_chunks; c++)
+    {
+      #pragma omp task depend(out: ready[c]) firstprivate(c) private(lo, hi)
+      {
+        lo = c*size/nb_chunks;
+        hi = (c+1)*size/nb_chunks;
+        TRACE_BEGIN(t);
+        sequential_quicksort(T+lo, hi-lo);
+        TRACE_END(t, "chunk sort", hi-lo);
+      }
+    }
+
+    // The outer loop keeps on doubling the number of chunks (`width`)
+    // already merged together
+    for (width = 1; width < nb_chunks; width+=width)
+    {
+      // Merge 2 consecutive groups of chunks for whole array
+      for (c = 0; c + width < nb_chunks; c+=2*width)
+      {
+        #pragma omp task depend(inout: ready[c]) depend(in: ready[c+width]) \
+                         firstprivate(c, width) private(lo, mid, hi)
+        {
+          lo = c*size/nb_chunks;
+          mid = (c+width)*size/nb_chunks;
+          hi = ((c+2*width < nb_chunks) ? c+2*width : nb_chunks)*size/nb_chunks;
+          TRACE_BEGIN(t);
+          merge_pair(T+lo, mid-lo, hi-mid);
+          TRACE_END(t, "merge", hi-lo);
+        }
+      }
+    }
+  }
+
+  free(ready);
+  return;
+
+}
+
+// ------------------------------------------------
+
+/* 
+   merge sort -- sequential, parallel -- 
+*/
+
+void insertion_sort (uint64_t *T, const uint64_t size)
+{
+  /* used for the leaves of the recursive sorts */
+  uint64_t i, j, temp;
+
+  for (i = 1; i < size; i++)
+  {
+    temp = T[i];
+    for (j = i; j > 0 && T[j-1] > temp; j--)
+    {
+      T[j] = T[j-1];
+    }
+    T[j] = temp;
+  }
+}
+
+void sequential_merge_sort (uint64_t *T, const uint64_t size)
+{
+    /* sequential implementation of merge sort */ 
+
+    // Small sub-arrays (tuning.leaf_size) are sorted by insertion
+    if(size <= tuning.leaf_size)
+    {
+      insertion_sort(T, size);
+      return;
+    }
+
+    // Divide into halves
+    sequential_merge_sort(T, size/2);
+    sequential_merge_sort(T+size/2, size-size/2);
+
+    // Merge the halves
+    merge_pair(T, size/2, size-size/2);
+
+
+    return ;
+}
+
+void parallel_merge_sort (uint64_t *T, const uint64_t size)
+{
+  /* parallel implementation of merge sort */
+
+  // Below tuning.task_cutoff a task costs more than it saves
+  if(size <= tuning.task_cutoff)
+  {
+    TRACE_BEGIN(t);
+    sequential_merge_sort(T, size);
+    TRACE_END(t, "leaf sort", size);
+    return;
+  }
+
+  
+  // Divide into halves
+
+  #pragma omp task
+  parallel_merge_sort(T, size/2);
+  #pragma omp task
+  parallel_merge_sort(T+size/2, size-size/2);
+      
+
+  // Merge the halves
+
+  TRACE_BEGIN(wait);
+  #pragma omp taskwait
+  TRACE_END(wait, "taskwait", size);
+
+  TRACE_BEGIN(t);
+  merge_pair(T, size/2, size-size/2);
+  TRACE_END(t, "merge", size);
+
+  return;
+}
+
+/*
+   dataflow merge sort -- no taskwait --
+
+   parallel_merge_sort waits at each node for both halves, so the thread
+   running the node is blocked until its slower half is done. Here only
+   the leaves are tasks: node n of the tree (children 2n+1 and 2n+2)
+   counts its unsorted halves, and the task that completes the last one
+   merges the node, then goes up while it keeps on being the last. A
+   subtree merges as soon as it is sorted, whatever the others do.
+*/
+
+typedef struct
+{
+  uint64_t *T;
+  uint64_t size;
+  int pending;      /* halves not sorted yet */
+} merge_node_t;
+
+static void merge_node_done (merge_node_t *nodes, uint64_t n)
+{
+  while (n > 0)
+  {
+    n = (n-1)/2;
+    if (__atomic_sub_fetch(&nodes[n].pending, 1, __ATOMIC_ACQ_REL) != 0)
+      return;
+
+    TRACE_BEGIN(t);
+    merge_pair(nodes[n].T, nodes[n].size/2, nodes[n].size-nodes[n].size/2);
+    TRACE_END(t, "merge", nodes[n].size);
+  }
+}
+
+static void spawn_merge_tree (merge_node_t *nodes, const uint64_t n, uint64_t *T, const uint64_t size)
+{
+  nodes[n].T = T;
+  nodes[n].size = size;
+  nodes[n].pending = 2;
+
+  if(size <= tuning.task_cutoff)
+  {
+    #pragma omp task
+    {
+      TRACE_BEGIN(t);
+      sequential_merge_sort(T, size);
+      TRACE_END(t, "leaf sort", size);
+      merge_node_done(nodes, n);
+    }
+    return;
+  }
+
+  spawn_merge_tree(nodes, 2*n+1, T, size/2);
+  spawn_merge_tree(nodes, 2*n+2, T+size/2, size-size/2);
+}
+
+void parallel_merge_sort_dataflow (uint64_t *T, const uint64_t size)
+{
+  uint64_t nb_nodes = 1, half = size;
+  merge_node_t *nodes;
+
+  if(size <= tuning.task_cutoff)
+  {
+    sequential_merge_sort(T, size);
+    return;
+  }
+
+  // The largest halves (rounded up) give the depth of the tree
+  while (half > tuning.task_cutoff)
+  {
+    half = half - half/2;
+    nb_nodes = 2*nb_nodes + 1;
+  }
+  nodes = (merge_node_t *) malloc(nb_nodes * sizeof(merge_node_t));
+
+  // Waits for all the leaves, and so for the merges they run
+  #pragma omp taskgroup
+  spawn_merge_tree(nodes, 0, T, size);
+
+  free(nodes);
+}
+
+void parallel_merge_sort_v2 (uint64_t *T, const uint64_t size, int threads)
+{
+  /* Optimized parallel version of merge sort */
+
+
+  if(threads == 1 || size <= tuning.task_cutoff)
+  {
+    sequential_merge_sort(T, size);
+  }
+  else if(threads >= 2)
+  {
+    // Divide into halves
+
+    #pragma omp task
+    parallel_merge_sort_v2(T, size/2,  threads/2);
+    #pragma omp task
+    parallel_merge_sort_v2(T+size/2, size-size/2, threads/2);
+
+
+    // Merge the halves
+
+    #pragma omp taskwait
+    merge_pair(T, size/2, size-size/2);
+  }
+
+
+  return;
+
+}
@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include <immintrin.h>
+
+#include "sorting.h"
+
+/*
+   Merge kernels shared by mergesort.c and quicksort.c.
+
+   Three implementations of the same two-way merge are provided:
+   - scalar: conditional moves instead of the data dependent branch,
+     which mispredicts about half of the time on random keys
+   - avx2: 4 x 64 bit bitonic merge network
+   - avx512: 8 x 64 bit bitonic merge network
+   The widest one supported by the CPU is picked at startup, the
+   MERGE_KERNEL environment variable (scalar, avx2, avx512) overrides it.
+*/
+
+/* below this many keys parallel_merge_runs() stays sequential */
+#define PARALLEL_MERGE_CUTOFF (1 << 16)
+
+typedef void (*merge_kernel_t) (uint64_t *, const uint64_t *, uint64_t,
+                                const uint64_t *, uint64_t);
+
+static merge_kernel_t merge_kernel ;
+static const char *merge_kernel_label ;
+
+
+static void merge_scalar (uint64_t *dst, const uint64_t *A, uint64_t na,
+                          const uint64_t *B, uint64_t nb)
+{
+  uint64_t i = 0 ;
+  uint64_t j = 0 ;
+  uint64_t k = 0 ;
+  uint64_t a, b, take_b ;
+
+  while ((i < na) && (j < nb))
+  {
+    a = A [i] ;
+    b = B [j] ;
+    take_b = b < a ;
+    dst [k] = take_b ? b : a ;
+    i = i + 1 - take_b ;
+    j = j + take_b ;
+    k = k + 1 ;
+  }
+
+  memcpy (dst + k, A + i, (na - i) * sizeof(uint64_t)) ;
+  k = k + na - i ;
+  memcpy (dst + k, B + j, (nb - j) * sizeof(uint64_t)) ;
+}
+
+/*
+   Common tail of the vector kernels: 'carry' holds the w largest
+   elements consumed so far, A[i..na) and B[j..nb) are what remains and
+   one of them is shorter than w.
+*/
+static void merge_tail (uint64_t *dst, uint64_t *carry, uint64_t w,
+                        const uint64_t *A, uint64_t na,
+                        const uint64_t *B, uint64_t nb)
+{
+  uint64_t tmp [32] ;
+
+  if (na < w)
+  {
+    merge_scalar (tmp, carry, w, A, na) ;
+    merge_scalar (dst, tmp, w + na, B, nb) ;
+  }
+  else
+  {
+    merge_scalar (tmp, carry, w, B, nb) ;
+    merge_scalar (dst, tmp, w + nb, A, na) ;
+  }
+}
+
+
+/* ------------------------------------------------ AVX2, 4 lanes */
+
+__attribute__((target("avx2")))
+static inline void minmax_avx2 (__m256i *a, __m256i *b)
+{
+  /* no unsigned 64 bit compare in AVX2: flip the sign bit */
+  const __m256i sign = _mm256_set1_epi64x ((long long) 0x8000000000000000ULL) ;
+  __m256i gt = _mm256_cmpgt_epi64 (_mm256_xor_si256 (*a, sign),
+                                   _mm256_xor_si256 (*b, sign)) ;
+  __m256i mn = _mm256_blendv_epi8 (*a, *b, gt) ;
+  __m256i mx = _mm256_blendv_epi8 (*b, *a, gt) ;
+  *a = mn ;
+  *b = mx ;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i bitonic_clean_avx2 (__m256i v)
+{
+  /* sort a bitonic sequence of 4: half cleaners at distance 2 then 1 */
+  __m256i t, mn, mx ;
+
+  t = _mm256_permute4x64_epi64 (v, 0x4E) ;
+  mn = v ; mx = t ;
+  minmax_avx2 (&mn, &mx) ;
+  v = _mm256_blend_epi32 (mn, mx, 0xF0) ;
+
+  t = _mm256_permute4x64_epi64 (v, 0xB1) ;
+  mn = v ; mx = t ;
+  minmax_avx2 (&mn, &mx) ;
+  v = _mm256_blend_epi32 (mn, mx, 0xCC) ;
+
+  return v ;
+}
+
+__attribute__((target("avx2")))
+static inline void bitonic_merge_avx2 (__m256i *a, __m256i *b)
+{
+  /* a, b sorted --> a = 4 smallest, b = 4 largest, both sorted */
+  *b = _mm256_permute4x64_epi64 (*b, 0x1B) ;
+  minmax_avx2 (a, b) ;
+  *a = bitonic_clean_avx2 (*a) ;
+  *b = bitonic_clean_avx2 (*b) ;
+}
+
+__attribute__((target("avx2")))
+static void merge_avx2 (uint64_t *dst, const uint64_t *A, uint64_t na,
+                        const uint64_t *B, uint64_t nb)
+{
+  uint64_t carry [4] ;
+  uint64_t i, j, k ;
+  __m256i va, vb ;
+
+  if (na < 4 || nb < 4)
+  {
+    merge_scalar (dst, A, na, B, nb) ;
+    return ;
+  }
+
+  va = _mm256_loadu_si256 ((const __m256i *) A) ;
+  vb = _mm256_loadu_si256 ((const __m256i *) B) ;
+  i = 4 ;
+  j = 4 ;
+  k = 0 ;
+
+  for (;;)
+  {
+    bitonic_merge_avx2 (&va, &vb) ;
+    _mm256_storeu_si256 ((__m256i *) (dst + k), va) ;
+    k = k + 4 ;
+
+    if (i + 4 > na || j + 4 > nb)
+      break ;
+
+    // Refill from the run whose next element is the smallest
+    if (A [i] <= B [j])
+    {
+      va = _mm256_loadu_si256 ((const __m256i *) (A + i)) ;
+      i = i + 4 ;
+    }
+    else
+    {
+      va = _mm256_loadu_si256 ((const __m256i *) (B + j)) ;
+      j = j + 4 ;
+    }
+  }
+
+  _mm256_storeu_si256 ((__m256i *) carry, vb) ;
+  merge_tail (dst + k, carry, 4, A + i, na - i, B + j, nb - j) ;
+}
+
+
+/* ------------------------------------------------ AVX-512, 8 lanes */
+
+__attribute__((target("avx512f")))
+static inline __m512i bitonic_clean_avx512 (__m512i v)
+{
+  /* sort a bitonic sequence of 8: half cleaners at distance 4, 2, 1 */
+  const __m512i d4 = _mm512_set_epi64 (3, 2, 1, 0, 7, 6, 5, 4) ;
+  const __m512i d2 = _mm512_set_epi64 (5, 4, 7, 6, 1, 0, 3, 2) ;
+  const __m512i d1 = _mm512_set_epi64 (6, 7, 4, 5, 2, 3, 0, 1) ;
+  __m512i t ;
+
+  t = _mm512_permutexvar_epi64 (d4, v) ;
+  v = _mm512_mask_blend_epi64 (0xF0, _mm512_min_epu64 (v, t), _mm512_max_epu64 (v, t)) ;
+  t = _mm512_permutexvar_epi64 (d2, v) ;
+  v = _mm512_mask_blend_epi64 (0xCC, _mm512_min_epu64 (v, t), _mm512_max_epu64 (v, t)) ;
+  t = _mm512_permutexvar_epi64 (d1, v) ;
+  v = _mm512_mask_blend_epi64 (0xAA, _mm512_min_epu64 (v, t), _mm512_max_epu64 (v, t)) ;
+
+  return v ;
+}
+
+__attribute__((target("avx512f")))
+static inline void bitonic_merge_avx512 (__m512i *a, __m512i *b)
+{
+  /* a, b sorted --> a = 8 smallest, b = 8 largest, both sorted */
+  const __m512i rev = _mm512_set_epi64 (0, 1, 2, 3, 4, 5, 6, 7) ;
+  __m512i r = _mm512_permutexvar_epi64 (rev, *b) ;
+  __m512i mn = _mm512_min_epu64 (*a, r) ;
+  __m512i mx = _mm512_max_epu64 (*a, r) ;
+
+  *a = bitonic_clean_avx512 (mn) ;
+  *b = bitonic_clean_avx512 (mx) ;
+}
+
+__attribute__((target("avx512f")))
+static void merge_avx512 (uint64_t *dst, const uint64_t *A, uint64_t na,
+                          const uint64_t *B, uint64_t nb)
+{
+  uint64_t carry [8] ;
+  uint64_t i, j, k ;
+  __m512i va, vb ;
+
+  if (na < 8 || nb < 8)
+  {
+    merge_scalar (dst, A, na, B, nb) ;
+    return ;
+  }
+
+  va = _mm512_loadu_si512 ((const void *) A) ;
+  vb = _mm512_loadu_si512 ((const void *) B) ;
+  i = 8 ;
+  j = 8 ;
+  k = 0 ;
+
+  for (;;)
+  {
+    bitonic_merge_avx512 (&va, &vb) ;
+    _mm512_storeu_si512 ((void *) (dst + k), va) ;
+    k = k + 8 ;
+
+    if (i + 8 > na || j + 8 > nb)
+      break ;
+
+    // Refill from the run whose next element is the smallest
+    if (A [i] <= B [j])
+    {
+      va = _mm512_loadu_si512 ((const void *) (A + i)) ;
+      i = i + 8 ;
+    }
+    else
+    {
+      va = _mm512_loadu_si512 ((const void *) (B + j)) ;
+      j = j + 8 ;
+    }
+  }
+
+  _mm512_storeu_si512 ((void *) carry, vb) ;
+  merge_tail (dst + k, carry, 8, A + i, na - i, B + j, nb - j) ;
+}
+
+
+/* ------------------------------------------------ runtime selection */
+
+__attribute__((constructor))
+static void select_merge_kernel (void)
+{
+  static const merge_kernel_t kernels [] = { merge_scalar, merge_avx2, merge_avx512 } ;
+  kernel_choice_t choices [3] ;
+  int k ;
+
+  __builtin_cpu_init () ;
+
+  choices[0] = (kernel_choice_t) { "scalar", 1 } ;
+  choices[1] = (kernel_choice_t) { "avx2", __builtin_cpu_supports ("avx2") } ;
+  choices[2] = (kernel_choice_t) { "avx512", __builtin_cpu_supports ("avx512f") } ;
+
+  k = select_kernel ("MERGE_KERNEL", choices, 3, 1) ;
+  merge_kernel = kernels[k] ;
+  merge_kernel_label = choices[k].name ;
+}
+
+const char *merge_kernel_name (void)
+{
+  return merge_kernel_label ;
+}
+
+void merge_runs (uint64_t *dst, const uint64_t *A, const uint64_t na,
+                 const uint64_t *B, const uint64_t nb)
+{
+  merge_kernel (dst, A, na, B, nb) ;
+}
+
+/*
+   Merge two sorted chunks of array T!
+   The two chunks are of size size
+   First chunck starts at T[0], second chunck starts at T[size]
+*/
+void merge (uint64_t *T, const uint64_t size)
+{
+  merge_pair (T, size, size) ;
+
+  return ;
+}
+
+/*
+   Same as merge() for chunks of different sizes: T[0..n1) and
+   T[n1..n1+n2)
+*/
+void merge_pair (uint64_t *T, const uint64_t n1, const uint64_t n2)
+{
+  uint64_t *X = arena_scratch (n1 + n2) ;
+
+  merge_runs (X, T, n1, T + n1, n2) ;
+
+  memcpy (T, X, (n1 + n2)*sizeof(uint64_t)) ;
+
+  return ;
+}
+
+/*
+   Number of keys taken from A among the first k keys of the merge of A
+   and B (ties go to A first): binary search on the diagonal k of the
+   merge path.
+*/
+uint64_t merge_co_rank (const uint64_t k, const uint64_t *A, const uint64_t na,
+                        const uint64_t *B, const uint64_t nb)
+{
+  uint64_t lo = (k > nb) ? k - nb : 0 ;
+  uint64_t hi = (k < na) ? k : na ;
+  uint64_t i, j ;
+
+  while (lo < hi)
+  {
+    i = (lo + hi) / 2 ;
+    j = k - i ;
+    // A[i] belongs to the first k keys if it is not larger than B[j-1]
+    if (j > 0 && A[i] <= B[j-1])
+      lo = i + 1 ;
+    else
+      hi = i ;
+  }
+  return lo ;
+}
+
+/*
+   merge_runs() by all the threads: the output is cut in one piece per
+   thread and the matching input ranges are found with merge_co_rank().
+*/
+void parallel_merge_runs (uint64_t *dst, const uint64_t *A, const uint64_t na,
+                          const uint64_t *B, const uint64_t nb)
+{
+  #pragma omp parallel if (na + nb > PARALLEL_MERGE_CUTOFF)
+  {
+    uint64_t nth = omp_get_num_threads () ;
+    uint64_t tid = omp_get_thread_num () ;
+    uint64_t k0 = (na + nb) * tid / nth ;
+    uint64_t k1 = (na + nb) * (tid + 1) / nth ;
+    uint64_t i0 = merge_co_rank (k0, A, na, B, nb) ;
+    uint64_t i1 = merge_co_rank (k1, A, na, B, nb) ;
+
+    merge_runs (dst + k0, A + i0, i1 - i0, B + (k0 - i0), (k1 - i1) - (k0 - i0)) ;
+  }
+}
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   Benchmark of the incremental merge-in of batches into a sorted array
+   against sorting the concatenation again after every batch.
+*/
+
+#define DEFAULT_NB_BATCHES 16
+
+
+static void resort_all (uint64_t *all, const uint64_t *X, const uint64_t N, const uint64_t nb_batches)
+{
+  /* baseline: append the batch and sort everything again */
+  uint64_t b, lo, hi ;
+
+  for (b = 0; b < nb_batches; b++)
+  {
+    lo = N * b / nb_batches ;
+    hi = N * (b + 1) / nb_batches ;
+    memcpy (all + lo, X + lo, (hi - lo) * sizeof(uint64_t)) ;
+    parallel_quicksort (all, hi) ;
+  }
+}
+
+static void merge_in_all (sorted_array_t *A, uint64_t *X, const uint64_t N, const uint64_t nb_batches)
+{
+  uint64_t b, lo, hi ;
+
+  for (b = 0; b < nb_batches; b++)
+  {
+    lo = N * b / nb_batches ;
+    hi = N * (b + 1) / nb_batches ;
+    sorted_array_insert (A, X + lo, hi - lo) ;
+  }
+}
+
+/* the state of both experiments */
+typedef struct
+{
+  uint64_t *X ;
+  uint64_t *Y ;
+  sorted_array_t A ;
+  uint64_t N ;
+  uint64_t nb_batches ;
+  uint64_t fingerprint ;
+} batches_t ;
+
+static void prepare_batches (void *arg, const unsigned int exp)
+{
+  batches_t *b = (batches_t *) arg ;
+
+  init_array_benchmark (b->X, b->N, exp, NULL) ;
+  b->fingerprint = multiset_fingerprint (b->X, b->N) ;
+  sorted_array_init (&b->A) ;
+}
+
+static void run_resort (void *arg)
+{
+  batches_t *b = (batches_t *) arg ;
+
+  resort_all (b->Y, b->X, b->N, b->nb_batches) ;
+}
+
+static void run_merge_in (void *arg)
+{
+  batches_t *b = (batches_t *) arg ;
+
+  merge_in_all (&b->A, b->X, b->N, b->nb_batches) ;
+}
+
+static const char *verify_resort (void *arg, const unsigned int exp)
+{
+  batches_t *b = (batches_t *) arg ;
+
+  sorted_array_free (&b->A) ;
+  if (! is_sorted (b->Y, b->N) || multiset_fingerprint (b->Y, b->N) != b->fingerprint)
+    return "failed" ;
+  return NULL ;
+}
+
+static const char *verify_merge_in (void *arg, const unsigned int exp)
+{
+  batches_t *b = (batches_t *) arg ;
+  int ok = b->A.size == b->N && is_sorted (b->A.keys, b->N)
+           && multiset_fingerprint (b->A.keys, b->N) == b->fingerprint ;
+
+  sorted_array_free (&b->A) ;
+  return ok ? NULL : "failed" ;
+}
+
+int main (int argc, char **argv)
+{
+  uint64_t av ;
+  sorted_array_t A ;
+
+  printf("================================================\n");
+  printf(" Max number of threads: %d \n", omp_get_max_threads());
+
+  /* the program takes the total size 2^N of the data and optionally the
+     number of batches it arrives in */
+  if (argc != 2 && argc != 3)
+  {
+      fprintf (stderr, "mergein.run N [nb_batches] \n") ;
+      exit (-1) ;
+  }
+
+  uint64_t N = 1UL << (atoi(argv[1])) ;
+  uint64_t nb_batches = (argc == 3) ? strtoull (argv[2], NULL, 10) : DEFAULT_NB_BATCHES ;
+  if (nb_batches == 0 || nb_batches > N) nb_batches = 1 ;
+
+  uint64_t *X = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+  uint64_t *Y = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+
+  printf(" --> %lu keys (2^%u) arriving in %lu batches\n", N, atoi(argv[1]), nb_batches);
+  #ifdef RINIT
+    printf("--> The array is initialized randomly\n");
+  #endif
+
+
+  batches_t b = { X, Y, { 0 }, N, nb_batches, 0 } ;
+  experiment_t resort = { &b, prepare_batches, run_resort, verify_resort } ;
+  experiment_t merge_in = { &b, prepare_batches, run_merge_in, verify_merge_in } ;
+
+  av = time_experiments ("re-sort every batch", &resort) ;
+  double resort_cycles = (double)av/1000000;
+  printf ("\n re-sort every batch \t%.2lf Mcycles\n", resort_cycles) ;
+
+  av = time_experiments ("merge-in every batch", &merge_in) ;
+  double merge_in_cycles = (double)av/1000000;
+  printf (" merge-in every batch \t%.2lf Mcycles\n\n", merge_in_cycles) ;
+
+  printf(" Speedup: \t\t%f\n", resort_cycles/merge_in_cycles);
+
+  /* before terminating, we run one extra test: both methods must end
+     with the same array */
+  sorted_array_init (&A) ;
+  uint64_t *Z = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+
+  #ifdef RINIT
+      init_array_random (X, N);
+  #else
+      init_array_sequence (X, N);
+  #endif
+
+  memcpy (Z, X, N * sizeof(uint64_t)) ;
+
+  resort_all (Y, X, N, nb_batches) ;
+  merge_in_all (&A, Z, N, nb_batches) ;
+
+  if (! are_vector_equals (Y, A.keys, N))
+  {
+      fprintf(stderr, "ERROR: re-sorting and merging in do not give the same result\n") ;
+      exit (-1) ;
+  }
+
+  sorted_array_free (&A) ;
+  arena_release (X) ;
+  arena_release (Y) ;
+  arena_release (Z) ;
+
+  printf("================================================\n\n");
+}
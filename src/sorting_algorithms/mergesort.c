@@ -1,201 +1,40 @@
 #include <stdio.h>
 #include <omp.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
-#include <x86intrin.h>
-
 #include "sorting.h"
 
 
-/* 
-   Merge two sorted chunks of array T!
-   The two chunks are of size size
-   First chunck starts at T[0], second chunck starts at T[size]
-*/
-void merge (uint64_t *T, const uint64_t size)
-{
-  uint64_t *X = (uint64_t *) malloc (2 * size * sizeof(uint64_t)) ;
-  
-  uint64_t i = 0 ;
-  uint64_t j = size ;
-  uint64_t k = 0 ;
-  
-  while ((i < size) && (j < 2*size))
-  {
-    if (T[i] < T [j])
-	  {
-      X [k] = T [i] ;
-      i = i + 1 ;
-	  }
-    else
-    {
-      X [k] = T [j] ;
-      j = j + 1 ;
-    }
-    k = k + 1 ;
-  }
-
-  if (i < size)
-  {
-    for (; i < size; i++, k++)
-    {
-      X [k] = T [i] ;
-    }
-  }
-  else
-  {
-    for (; j < 2*size; j++, k++)
-    {
-      X [k] = T [j] ;
-    }
-  }
-  
-  memcpy (T, X, 2*size*sizeof(uint64_t)) ;
-  free (X) ;
-  
-  return ;
-}
-
-
-
-
-
-/* 
-   merge sort -- sequential, parallel -- 
-*/
-
-void sequential_merge_sort (uint64_t *T, const uint64_t size)
-{
-    /* sequential implementation of merge sort */ 
-
-    uint64_t temp;
-
-    // When only 2 elements remain
-    if(size==2)
-    {
-      // Swap elements if required
-      if(T[1] < T[0])
-      {
-        temp = T[1];
-        T[1] = T[0];
-        T[0] = temp;
-        return;
-      }
-      else
-      {
-        return;
-      }
-    }
-
-    // Divide into equal halves
-    sequential_merge_sort(T, size/2);
-    sequential_merge_sort(T+size/2, size/2);
-
-    // Merge the halves
-    merge(T, size/2);
-
-
-    return ;
-}
-
-void parallel_merge_sort (uint64_t *T, const uint64_t size)
+static void merge_sort_in_region (uint64_t *T, const uint64_t size)
 {
-  /* parallel implementation of merge sort */
-
-  uint64_t temp;
-
-  // When only 2 elements remain
-  if(size==2)
-  {
-    // Swap elements if required
-    if(T[1] < T[0])
-    {
-      temp = T[1];
-      T[1] = T[0];
-      T[0] = temp;
-      return;
-    }
-    else
+    #pragma omp parallel if (size > tuning.sequential_cutoff)
     {
-      return;
+      #pragma omp single
+      parallel_merge_sort (T, size) ;
     }
-  }
-
-  
-  // Divide into equal halves
-
-  #pragma omp task
-  parallel_merge_sort(T, size/2);
-  #pragma omp task
-  parallel_merge_sort(T+size/2, size/2);
-      
-
-  // Merge the halves
-
-  #pragma omp taskwait
-  merge(T, size/2);
-
-  return;
 }
 
-void parallel_merge_sort_v2 (uint64_t *T, const uint64_t size, int threads)
+static void dataflow_sort_in_region (uint64_t *T, const uint64_t size)
 {
-  /* Optimized parallel version of merge sort */
-
-
-  uint64_t temp;
-
-  // When only 2 elements remain
-  if(size==2)
-  {
-    // Swap elements if required
-    if(T[1] < T[0])
+    #pragma omp parallel if (size > tuning.sequential_cutoff)
     {
-      temp = T[1];
-      T[1] = T[0];
-      T[0] = temp;
-      return;
+      #pragma omp single
+      parallel_merge_sort_dataflow (T, size) ;
     }
-    else
-    {
-      return;
-    }
-  }
-
-  if(threads == 1)
-  {
-    sequential_merge_sort(T, size);
-  }
-  else if(threads >= 2)
-  {
-    // Divide into equal halves
-
-    #pragma omp task
-    parallel_merge_sort_v2(T, size/2,  threads/2);
-    #pragma omp task
-    parallel_merge_sort_v2(T+size/2, size/2, threads/2);
-
-
-    // Merge the halves
-
-    #pragma omp taskwait
-    merge(T, size/2);
-  }
-
-
-  return;
-
 }
 
 int main (int argc, char **argv)
 {
-    uint64_t start, end;
     uint64_t av ;
-    unsigned int exp ;
+    uint64_t bytes, passes ;
+    mem_counters_t counters ;
 
     printf("================================================\n");
     printf(" Max number of threads: %d \n", omp_get_max_threads());
+    print_tuning () ;
+    printf(" Merge kernel: %s \n", merge_kernel_name());
 
     /* the program takes one parameter N which is the size of the array to
        be sorted. The array will have size 2^N */
@@ -207,7 +46,7 @@ int main (int argc, char **argv)
 
     uint64_t N = 1 << (atoi(argv[1])) ;
     /* the array to be sorted */
-    uint64_t *X = (uint64_t *) malloc (N * sizeof(uint64_t)) ;
+    uint64_t *X = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
 
     printf(" --> Sorting an array of size %lu (2^%u)\n", N, atoi(argv[1]));
     #ifdef RINIT
@@ -215,101 +54,53 @@ int main (int argc, char **argv)
     #endif
     
 
-    for (exp = 0 ; exp < NBEXPERIMENTS; exp++)
-    {
-        #ifdef RINIT
-            init_array_random (X, N);
-        #else
-            init_array_sequence (X, N);
-        #endif
-            
-        
-        start = _rdtsc () ;
-        
-        sequential_merge_sort (X, N) ;
-        
-        end = _rdtsc () ;
-        experiments [exp] = end - start ;
-
-        /* verifying that X is properly sorted */
-        #ifdef RINIT
-        if (! is_sorted (X, N))
-        {
-            fprintf(stderr, "ERROR: the sequential sorting of the array failed\n") ;
-            print_array (X, N) ;
-            exit (-1) ;
-        }
-        #else
-        if (! is_sorted_sequence (X, N))
-        {
-            fprintf(stderr, "ERROR: the sequential sorting of the array failed\n") ;
-            print_array (X, N) ;
-            exit (-1) ;
-        }
-        #endif
-    }
-
-    av = average_time() ;  
+    mem_counters_start (&counters) ;
+    av = time_sort_experiments ("mergesort serial", sequential_merge_sort, X, N, init_array_benchmark, NULL) ;
+    mem_counters_stop (&counters) ;
 
     double serial_cycles = (double)av/1000000;
     printf ("\n mergesort serial \t%.2lf Mcycles\n\n", serial_cycles) ;
+    print_mem_counters ("serial", &counters) ;
+    write_mem_counters_csv ("mergesort", "serial", N, av, &counters) ;
+    bytes = merge_sort_traffic (N, 1, &passes) ;
+    print_bandwidth ("serial", bytes, passes, av) ;
 
   
-    for (exp = 0 ; exp < NBEXPERIMENTS; exp++)
-    {
-        #ifdef RINIT
-                init_array_random (X, N);
-        #else
-                init_array_sequence (X, N);
-        #endif
-        
-        start = _rdtsc () ;
-        #pragma omp parallel
-        {
-          #pragma omp single
-          {
-            parallel_merge_sort (X, N) ;
-            // parallel_merge_sort_v2 (X, N, omp_get_max_threads()) ;
-            // printf("Hemnlo!\n");
-          }
-        }
-        
-        
-        end = _rdtsc () ;
-        experiments [exp] = end - start ;
+    mem_counters_start (&counters) ;
+    av = time_sort_experiments ("mergesort parallel", merge_sort_in_region, X, N, init_array_benchmark, NULL) ;
+    mem_counters_stop (&counters) ;
 
-        /* verifying that X is properly sorted */
-        #ifdef RINIT
-        if (! is_sorted (X, N))
-        {
-            fprintf(stderr, "ERROR: the parallel sorting of the array failed\n") ;
-            exit (-1) ;
-	    }
-        #else
-        if (! is_sorted_sequence (X, N))
-        {
-            fprintf(stderr, "ERROR: the parallel sorting of the array failed\n") ;
-            print_array (X, N);
-            exit (-1) ;
-        }
-        #endif
-                
-    }
-    
-    av = average_time() ;  
     double parallel_cycles = (double)av/1000000;
     printf (" mergesort parallel \t%.2lf Mcycles\n\n", (double)av/1000000) ;
+    print_mem_counters ("parallel", &counters) ;
+    write_mem_counters_csv ("mergesort", "parallel", N, av, &counters) ;
+    bytes = merge_sort_traffic (N, (N > tuning.sequential_cutoff) ? omp_get_max_threads () : 1, &passes) ;
+    print_bandwidth ("parallel", bytes, passes, av) ;
     
+    mem_counters_start (&counters) ;
+    av = time_sort_experiments ("mergesort dataflow", dataflow_sort_in_region, X, N, init_array_benchmark, NULL) ;
+    mem_counters_stop (&counters) ;
+
+    double dataflow_cycles = (double)av/1000000;
+    printf (" mergesort dataflow \t%.2lf Mcycles\n\n", dataflow_cycles) ;
+    print_mem_counters ("dataflow", &counters) ;
+    write_mem_counters_csv ("mergesort", "dataflow", N, av, &counters) ;
+    printf(" Dataflow vs taskwait: \t%f\n\n", parallel_cycles/dataflow_cycles);
+
     FILE *f = fopen("speedups.txt", "a+w");
 
     printf(" Speedup: \t\t%f\n", serial_cycles/parallel_cycles);
     fprintf(f, "%f\n", serial_cycles/parallel_cycles);
 
+    const char *variants [] = { "mergesort serial", "mergesort parallel", "mergesort dataflow" } ;
+    double variant_cycles [] = { serial_cycles, parallel_cycles, dataflow_cycles } ;
+    report_baselines (init_array_benchmark, NULL, N, variants, variant_cycles, 3) ;
+
     /* print_array (X, N) ; */
 
     /* before terminating, we run one extra test of the algorithm */
-    uint64_t *Y = (uint64_t *) malloc (N * sizeof(uint64_t)) ;
-    uint64_t *Z = (uint64_t *) malloc (N * sizeof(uint64_t)) ;
+    uint64_t *Y = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+    uint64_t *Z = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
 
     #ifdef RINIT
         init_array_random (Y, N);
@@ -329,9 +120,9 @@ int main (int argc, char **argv)
     }
 
 
-    free(X);
-    free(Y);
-    free(Z);
+    arena_release(X);
+    arena_release(Y);
+    arena_release(Z);
 
     printf("================================================\n\n");
     
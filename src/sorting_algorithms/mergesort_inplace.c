@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   in-place merge sort -- sequential, parallel --
+
+   Same divide and conquer structure as mergesort.c, but the two sorted
+   halves are merged with rotations instead of a 2*size scratch buffer
+   (SymMerge, Kim & Kutzner 2004). The only auxiliary memory is the
+   O(log^2 n) recursion stack, so arrays close to the RAM size can be
+   sorted. The price is O(n log n) work per merge instead of O(n).
+*/
+
+/* the leaf size and the size below which the recursion (sort or merge)
+   does not spawn tasks come from the tuning profile */
+
+static void reverse (uint64_t *T, uint64_t a, uint64_t b)
+{
+  /* reverse T[a..b) */
+  uint64_t temp;
+
+  while (b > a + 1)
+  {
+    b = b - 1;
+    temp = T[a];
+    T[a] = T[b];
+    T[b] = temp;
+    a = a + 1;
+  }
+}
+
+static void rotate (uint64_t *T, uint64_t a, uint64_t m, uint64_t b)
+{
+  /* T[a..m) T[m..b) --> T[m..b) T[a..m), three reversals, no buffer */
+  reverse (T, a, m);
+  reverse (T, m, b);
+  reverse (T, a, b);
+}
+
+/*
+   Merge the sorted runs T[a..m) and T[m..b) in place.
+   Tasks are spawned for the two independent sub-merges when parallel
+   is non zero and the range is large enough.
+*/
+static void sym_merge (uint64_t *T, uint64_t a, uint64_t m, uint64_t b,
+                       int parallel)
+{
+  uint64_t i, j, h, mid, n, start, r, p, c, end, temp;
+
+  if (m - a == 1)
+  {
+    // Insert T[a] into T[m..b)
+    i = m;
+    j = b;
+    while (i < j)
+    {
+      h = (i + j) / 2;
+      if (T[h] < T[a]) i = h + 1;
+      else j = h;
+    }
+    temp = T[a];
+    memmove (T + a, T + a + 1, (i - 1 - a) * sizeof(uint64_t));
+    T[i-1] = temp;
+    return;
+  }
+  if (b - m == 1)
+  {
+    // Insert T[m] into T[a..m)
+    i = a;
+    j = m;
+    while (i < j)
+    {
+      h = (i + j) / 2;
+      if (!(T[m] < T[h])) i = h + 1;
+      else j = h;
+    }
+    temp = T[m];
+    memmove (T + i + 1, T + i, (m - i) * sizeof(uint64_t));
+    T[i] = temp;
+    return;
+  }
+
+  // Find the split point so that T[start..m) and T[m..end) can be
+  // swapped around the middle of the range
+  mid = (a + b) / 2;
+  n = mid + m;
+  if (m > mid)
+  {
+    start = n - b;
+    r = mid;
+  }
+  else
+  {
+    start = a;
+    r = m;
+  }
+  p = n - 1;
+  while (start < r)
+  {
+    c = (start + r) / 2;
+    if (!(T[p-c] < T[c])) start = c + 1;
+    else r = c;
+  }
+  end = n - start;
+
+  if (start < m && m < end)
+  {
+    rotate (T, start, m, end);
+  }
+
+  if (parallel && b - a > tuning.task_cutoff)
+  {
+    #pragma omp task
+    if (a < start && start < mid) sym_merge (T, a, start, mid, parallel);
+    #pragma omp task
+    if (mid < end && end < b) sym_merge (T, mid, end, b, parallel);
+    #pragma omp taskwait
+  }
+  else
+  {
+    if (a < start && start < mid) sym_merge (T, a, start, mid, 0);
+    if (mid < end && end < b) sym_merge (T, mid, end, b, 0);
+  }
+}
+
+
+void sequential_inplace_merge_sort (uint64_t *T, const uint64_t size)
+{
+  /* sequential implementation of in-place merge sort */
+
+  if (size <= tuning.leaf_size)
+  {
+    insertion_sort (T, size);
+    return;
+  }
+
+  // Divide into halves
+  sequential_inplace_merge_sort (T, size/2);
+  sequential_inplace_merge_sort (T+size/2, size - size/2);
+
+  // Merge the halves without a scratch buffer
+  if (T[size/2 - 1] > T[size/2])
+  {
+    sym_merge (T, 0, size/2, size, 0);
+  }
+
+  return;
+}
+
+void parallel_inplace_merge_sort (uint64_t *T, const uint64_t size)
+{
+  /* parallel implementation of in-place merge sort, to be called from
+     inside a parallel/single region like parallel_merge_sort */
+
+  if (size <= tuning.task_cutoff)
+  {
+    sequential_inplace_merge_sort (T, size);
+    return;
+  }
+
+  // Divide into halves
+
+  #pragma omp task
+  parallel_inplace_merge_sort (T, size/2);
+  #pragma omp task
+  parallel_inplace_merge_sort (T+size/2, size - size/2);
+
+  // Merge the halves, the merge itself spawns tasks
+
+  #pragma omp taskwait
+  if (T[size/2 - 1] > T[size/2])
+  {
+    sym_merge (T, 0, size/2, size, 1);
+  }
+
+  return;
+}
+
+static void inplace_sort_in_region (uint64_t *T, const uint64_t size)
+{
+    #pragma omp parallel if (size > tuning.sequential_cutoff)
+    {
+      #pragma omp single
+      parallel_inplace_merge_sort (T, size) ;
+    }
+}
+
+int main (int argc, char **argv)
+{
+    uint64_t av ;
+    mem_counters_t counters ;
+
+    printf("================================================\n");
+    printf(" Max number of threads: %d \n", omp_get_max_threads());
+    print_tuning () ;
+
+    /* the program takes one parameter N which is the size of the array to
+       be sorted. The array will have size 2^N */
+    if (argc != 2)
+    {
+        fprintf (stderr, "mergesort_inplace.run N \n") ;
+        exit (-1) ;
+    }
+
+    uint64_t N = 1UL << (atoi(argv[1])) ;
+    /* the array to be sorted */
+    uint64_t *X = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+
+    printf(" --> Sorting an array of size %lu (2^%u)\n", N, atoi(argv[1]));
+    #ifdef RINIT
+      printf("--> The array is initialized randomly\n");
+    #endif
+
+
+    mem_counters_start (&counters) ;
+    av = time_sort_experiments ("mergesort in-place serial", sequential_inplace_merge_sort, X, N,
+                                init_array_benchmark, NULL) ;
+    mem_counters_stop (&counters) ;
+
+    double serial_cycles = (double)av/1000000;
+    printf ("\n mergesort in-place serial \t%.2lf Mcycles\n\n", serial_cycles) ;
+    print_mem_counters ("serial", &counters) ;
+    write_mem_counters_csv ("mergesort_inplace", "serial", N, av, &counters) ;
+
+
+    mem_counters_start (&counters) ;
+    av = time_sort_experiments ("mergesort in-place parallel", inplace_sort_in_region, X, N,
+                                init_array_benchmark, NULL) ;
+    mem_counters_stop (&counters) ;
+
+    double parallel_cycles = (double)av/1000000;
+    printf (" mergesort in-place parallel \t%.2lf Mcycles\n\n", parallel_cycles) ;
+    print_mem_counters ("parallel", &counters) ;
+    write_mem_counters_csv ("mergesort_inplace", "parallel", N, av, &counters) ;
+
+    /* only X has been allocated so far, so the peak is the array plus
+       whatever the in-place sorts needed on top of it */
+    printf (" Array size \t\t\t%.2lf MiB\n", (double)(N * sizeof(uint64_t))/(1024*1024)) ;
+    printf (" Peak resident memory \t\t%.2lf MiB\n\n", (double)peak_memory_kb()/1024) ;
+
+    FILE *f = fopen("speedups.txt", "a+w");
+
+    printf(" Speedup: \t\t\t%f\n", serial_cycles/parallel_cycles);
+    fprintf(f, "%f\n", serial_cycles/parallel_cycles);
+
+    /* before terminating, we run one extra test of the algorithm */
+    uint64_t *Y = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+    uint64_t *Z = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+
+    #ifdef RINIT
+        init_array_random (Y, N);
+    #else
+        init_array_sequence (Y, N);
+    #endif
+
+    memcpy(Z, Y, N * sizeof(uint64_t));
+
+    sequential_inplace_merge_sort (Y, N) ;
+    #pragma omp parallel
+    {
+      #pragma omp single
+      parallel_inplace_merge_sort (Z, N) ;
+    }
+
+    if (! are_vector_equals (Y, Z, N)) {
+        fprintf(stderr, "ERROR: sorting with the sequential and the parallel algorithm does not give the same result\n") ;
+        exit (-1) ;
+    }
+
+
+    arena_release(X);
+    arena_release(Y);
+    arena_release(Z);
+
+    printf("================================================\n\n");
+
+}
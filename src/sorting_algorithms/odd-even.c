@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <omp.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <x86intrin.h>
+#include <immintrin.h>
 #include <stdbool.h>
 
 #include "sorting.h"
@@ -18,84 +20,181 @@ element in an odd position with the next one. In the 2nd one, we dp the same wit
 every element in even pos.
 */
 
-/*This implementation allows to do that in one For loop using startIndex to
-interleave between odds and evens.
+/* A phase is a set of independent compare-exchanges on the pairs
+(T[i], T[i+1]), i = start, start+2, ... The kernels below split the pairs
+into a vector of first elements and a vector of second elements, take
+their min/max and interleave them back, and OR the comparison masks
+together instead of branching to know whether anything moved. The widest
+kernel supported by the CPU is picked at startup, the ODDEVEN_KERNEL
+environment variable (scalar, avx2, avx512) overrides it.
+*/
+
+/* pairs handed to a thread at once by the parallel phases */
+#define ODDEVEN_BLOCK 4096
+
+typedef uint64_t (*phase_kernel_t) (uint64_t *, uint64_t);
+
+static phase_kernel_t phase_kernel ;
+static const char *phase_kernel_label ;
+
+
+static uint64_t phase_scalar (uint64_t *T, uint64_t nb_pairs)
+{
+    /* compare-exchange T[2p], T[2p+1] for p < nb_pairs, returns non zero
+       when a pair was swapped */
+    uint64_t changed = 0 ;
+    uint64_t p, a, b, gt ;
+
+    for (p = 0; p < nb_pairs; p++)
+    {
+        a = T[2*p] ;
+        b = T[2*p+1] ;
+        gt = a > b ;
+        T[2*p] = gt ? b : a ;
+        T[2*p+1] = gt ? a : b ;
+        changed |= gt ;
+    }
+    return changed ;
+}
+
+__attribute__((target("avx2")))
+static uint64_t phase_avx2 (uint64_t *T, uint64_t nb_pairs)
+{
+    /* 4 pairs per step; unpacklo/hi work within 128 bit lanes, so the
+       pairs come out in the order 0 2 1 3 and go back the same way */
+    const __m256i sign = _mm256_set1_epi64x ((long long) 0x8000000000000000ULL) ;
+    __m256i changed = _mm256_setzero_si256 () ;
+    __m256i a, b, lo, hi, gt, mn, mx ;
+    uint64_t p ;
+
+    for (p = 0; p + 4 <= nb_pairs; p += 4)
+    {
+        a = _mm256_loadu_si256 ((__m256i *) (T + 2*p)) ;
+        b = _mm256_loadu_si256 ((__m256i *) (T + 2*p + 4)) ;
+        lo = _mm256_unpacklo_epi64 (a, b) ;
+        hi = _mm256_unpackhi_epi64 (a, b) ;
+
+        // no unsigned 64 bit compare in AVX2: flip the sign bit
+        gt = _mm256_cmpgt_epi64 (_mm256_xor_si256 (lo, sign), _mm256_xor_si256 (hi, sign)) ;
+        mn = _mm256_blendv_epi8 (lo, hi, gt) ;
+        mx = _mm256_blendv_epi8 (hi, lo, gt) ;
+        changed = _mm256_or_si256 (changed, gt) ;
+
+        _mm256_storeu_si256 ((__m256i *) (T + 2*p), _mm256_unpacklo_epi64 (mn, mx)) ;
+        _mm256_storeu_si256 ((__m256i *) (T + 2*p + 4), _mm256_unpackhi_epi64 (mn, mx)) ;
+    }
+
+    return (uint64_t) ! _mm256_testz_si256 (changed, changed) | phase_scalar (T + 2*p, nb_pairs - p) ;
+}
+
+__attribute__((target("avx512f")))
+static uint64_t phase_avx512 (uint64_t *T, uint64_t nb_pairs)
+{
+    /* 8 pairs per step */
+    const __m512i first = _mm512_set_epi64 (14, 12, 10, 8, 6, 4, 2, 0) ;
+    const __m512i second = _mm512_set_epi64 (15, 13, 11, 9, 7, 5, 3, 1) ;
+    const __m512i low_half = _mm512_set_epi64 (11, 3, 10, 2, 9, 1, 8, 0) ;
+    const __m512i high_half = _mm512_set_epi64 (15, 7, 14, 6, 13, 5, 12, 4) ;
+    __mmask8 changed = 0 ;
+    __m512i a, b, lo, hi, mn, mx ;
+    uint64_t p ;
+
+    for (p = 0; p + 8 <= nb_pairs; p += 8)
+    {
+        a = _mm512_loadu_si512 (T + 2*p) ;
+        b = _mm512_loadu_si512 (T + 2*p + 8) ;
+        lo = _mm512_permutex2var_epi64 (a, first, b) ;
+        hi = _mm512_permutex2var_epi64 (a, second, b) ;
+
+        changed |= _mm512_cmpgt_epu64_mask (lo, hi) ;
+        mn = _mm512_min_epu64 (lo, hi) ;
+        mx = _mm512_max_epu64 (lo, hi) ;
+
+        _mm512_storeu_si512 (T + 2*p, _mm512_permutex2var_epi64 (mn, low_half, mx)) ;
+        _mm512_storeu_si512 (T + 2*p + 8, _mm512_permutex2var_epi64 (mn, high_half, mx)) ;
+    }
+
+    return (uint64_t) (changed != 0) | phase_scalar (T + 2*p, nb_pairs - p) ;
+}
+
+__attribute__((constructor))
+static void select_phase_kernel (void)
+{
+    static const phase_kernel_t kernels [] = { phase_scalar, phase_avx2, phase_avx512 } ;
+    kernel_choice_t choices [3] ;
+    int k ;
+
+    __builtin_cpu_init () ;
+
+    choices[0] = (kernel_choice_t) { "scalar", 1 } ;
+    choices[1] = (kernel_choice_t) { "avx2", __builtin_cpu_supports ("avx2") } ;
+    choices[2] = (kernel_choice_t) { "avx512", __builtin_cpu_supports ("avx512f") } ;
+
+    k = select_kernel ("ODDEVEN_KERNEL", choices, 3, 1) ;
+    phase_kernel = kernels[k] ;
+    phase_kernel_label = choices[k].name ;
+}
+
+
+/* Both phases are run before looking at the result: a phase with no swap
+only means the pairs of that parity are in order, the array is sorted once
+two consecutive phases swap nothing.
 */
 void sequential_oddeven_sort (uint64_t *T, const uint64_t size)
 {
-    /* TODO: sequential implementation of odd-even sort */
-    uint64_t startIndex, i, temp, sorted;
+    uint64_t changed ;
+
+    if (size < 2)
+        return ;
 
-    
-    startIndex = 0;
     do
-    {   
-        sorted = 1;
-        for(i = startIndex; i < size-1; i+=2)
-        {
-            if (T[i] > T[i+1])
-            {
-                temp = T[i+1];
-                T[i+1] = T[i];
-                T[i] = temp;
-
-                sorted = 0;
-            }
-        }
-        startIndex = 1 - startIndex;
-    } while (sorted == 0);
+    {
+        changed = phase_kernel (T, size / 2) ;
+        changed |= phase_kernel (T + 1, (size - 1) / 2) ;
+    } while (changed) ;
     return ;
 }
 
 
+static uint64_t parallel_phase (uint64_t *T, const uint64_t nb_pairs)
+{
+    /* the pairs are split into blocks of ODDEVEN_BLOCK among the threads */
+    uint64_t changed = 0 ;
+    uint64_t b ;
+
+    #pragma omp parallel for schedule(static) reduction(|:changed)
+    for (b = 0; b < nb_pairs; b += ODDEVEN_BLOCK)
+    {
+        changed |= phase_kernel (T + 2*b, (nb_pairs - b < ODDEVEN_BLOCK) ? nb_pairs - b : ODDEVEN_BLOCK) ;
+    }
+    return changed ;
+}
+
 void parallel_oddeven_sort (uint64_t *T, const uint64_t size)
 {
+    uint64_t changed ;
+
+    // Small arrays (tuning.sequential_cutoff) are not worth waking the threads
+    if (size <= tuning.sequential_cutoff)
+    {
+        sequential_oddeven_sort(T, size);
+        return;
+    }
 
-    /* TODO: parallel implementation of odd-even sort */ 
-    uint64_t startIndex, i, temp, sorted, chunk_sz;
-    
-    chunk_sz = size / omp_get_max_threads();
-    // startIndex = 0;
     do
     {
-        sorted = 1;
-	/*We split the array in chunks and try to swap odds-possitioned elems inside each chunk with threads*/    
-        #pragma omp parallel for private(temp)
-        for(i = 0; i < size-1; i+=2)
-        {
-            if (T[i] > T[i+1])
-            {
-                temp = T[i+1];
-                T[i+1] = T[i];
-                T[i] = temp;
-
-                sorted = 0;
-            }
-        }
-	/*When all prevouis threads have finished, try to swap even-pos elems inside same chunk partitions*/
-        #pragma omp parallel for private(temp)
-        for(i = 1; i < size-1; i+=2)
-        {
-            if (T[i] > T[i+1])
-            {
-                temp = T[i+1];
-                T[i+1] = T[i];
-                T[i] = temp;
-
-                sorted = 0;
-            }
-        }
-        // startIndex = 1 - startIndex;
-    } while (sorted == 0);
+	/*When all the odd-positioned pairs are done, the even-positioned ones*/
+        changed = parallel_phase (T, size / 2) ;
+        changed |= parallel_phase (T + 1, (size - 1) / 2) ;
+    } while (changed) ;
     return ;
 }
 
 
 int main (int argc, char **argv)
 {
-    uint64_t start, end;
     uint64_t av ;
-    unsigned int exp ;
+    mem_counters_t counters ;
 
     /* the program takes one parameter N which is the size of the array to
        be sorted. The array will have size 2^N */
@@ -107,104 +206,51 @@ int main (int argc, char **argv)
 
     uint64_t N = 1 << (atoi(argv[1])) ;
     /* the array to be sorted */
-    uint64_t *X = (uint64_t *) malloc (N * sizeof(uint64_t)) ;
+    uint64_t *X = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
 
     printf("================================================\n");
     printf(" Max number of threads: %d \n", omp_get_max_threads());    
+    print_tuning () ;
+    printf(" Odd-even kernel: %s \n", phase_kernel_label);
     printf(" --> Sorting an array of size %lu (2^%u)\n", N, atoi(argv[1]));
 #ifdef RINIT
     printf("--> The array is initialized randomly\n");
 #endif
     
 
-    for (exp = 0 ; exp < NBEXPERIMENTS; exp++){
-#ifdef RINIT
-        init_array_random (X, N);
-#else
-        init_array_sequence (X, N);
-#endif
-        
-      
-        start = _rdtsc () ;
-        
-        sequential_oddeven_sort (X, N) ;
-     
-        end = _rdtsc () ;
-        experiments [exp] = end - start ;
-
-        /* verifying that X is properly sorted */
-#ifdef RINIT
-        if (! is_sorted (X, N))
-        {
-            fprintf(stderr, "ERROR: the sequential sorting of the array failed\n") ;
-            print_array (X, N) ;
-            exit (-1) ;
-	}
-#else
-        if (! is_sorted_sequence (X, N))
-        {
-            fprintf(stderr, "ERROR: the sequential sorting of the array failed\n") ;
-            print_array (X, N) ;
-            exit (-1) ;
-	}
-#endif
-    }
-
-    av = average_time() ;  
+    mem_counters_start (&counters) ;
+    av = time_sort_experiments ("odd-even serial", sequential_oddeven_sort, X, N, init_array_benchmark, NULL) ;
+    mem_counters_stop (&counters) ;
 
     double serial_cycles = (double)av/1000000;
     printf ("\n odd-even serial \t\t\t %.2lf Mcycles\n", (double)av/1000000) ;
+    print_mem_counters ("serial", &counters) ;
+    write_mem_counters_csv ("odd-even", "serial", N, av, &counters) ;
 
   
-    for (exp = 0 ; exp < NBEXPERIMENTS; exp++)
-    {
-#ifdef RINIT
-        init_array_random (X, N);
-#else
-        init_array_sequence (X, N);
-#endif
-        
-        start = _rdtsc () ;
-
-        parallel_oddeven_sort (X, N) ;
-     
-        end = _rdtsc () ;
-        experiments [exp] = end - start ;
-
-        /* verifying that X is properly sorted */
-#ifdef RINIT
-        if (! is_sorted (X, N))
-        {
-            fprintf(stderr, "ERROR: the parallel sorting of the array failed\n") ;
-            exit (-1) ;
-	}
-#else
-        if (! is_sorted_sequence (X, N))
-        {
-            fprintf(stderr, "ERROR: the parallel sorting of the array failed\n") ;
-            print_array (X, N) ;
-            exit (-1) ;
-	}
-#endif
-                
-        
-    }
-    
-    av = average_time() ;  
+    mem_counters_start (&counters) ;
+    av = time_sort_experiments ("odd-even parallel", parallel_oddeven_sort, X, N, init_array_benchmark, NULL) ;
+    mem_counters_stop (&counters) ;
 
     double parallel_cycles = (double)av/1000000;
     printf ("\n odd-even parallel \t\t %.2lf Mcycles\n\n", (double)av/1000000) ;
+    print_mem_counters ("parallel", &counters) ;
+    write_mem_counters_csv ("odd-even", "parallel", N, av, &counters) ;
 
     FILE *f = fopen("speedups_odd.txt", "a+w");
 
     printf(" Speedup: \t\t%f\n", serial_cycles/parallel_cycles);
     fprintf(f, "%f\n", serial_cycles/parallel_cycles);
+
+    const char *variants [] = { "odd-even serial", "odd-even parallel" } ;
+    double variant_cycles [] = { serial_cycles, parallel_cycles } ;
+    report_baselines (init_array_benchmark, NULL, N, variants, variant_cycles, 2) ;
   
     /* print_array (X, N) ; */
 
     /* before terminating, we run one extra test of the algorithm */
-    uint64_t *Y = (uint64_t *) malloc (N * sizeof(uint64_t)) ;
-    uint64_t *Z = (uint64_t *) malloc (N * sizeof(uint64_t)) ;
+    uint64_t *Y = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+    uint64_t *Z = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
 
 #ifdef RINIT
     init_array_random (Y, N);
@@ -223,9 +269,9 @@ int main (int argc, char **argv)
     }
 
 
-    free(X);
-    free(Y);
-    free(Z);
+    arena_release(X);
+    arena_release(Y);
+    arena_release(Z);
     
     printf("================================================\n\n");
 }
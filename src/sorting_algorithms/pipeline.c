@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   pipeline -- sorting a stream of arrays --
+
+   The serial loop does what the other benchmarks do for each array:
+   initialize, sort, verify. The pipelined loop submits the sort of array
+   i with sort_submit() and, while it runs on the sort thread, generates
+   array i+1 and verifies array i-1 in two OpenMP sections, with three
+   buffers in rotation. The sum of the sort times alone is the best the
+   pipeline can do. The sections take their cores from the team of the
+   sort, which would otherwise share them with two more threads.
+*/
+
+#define PIPELINE_BUFFERS 3
+
+/* threads of the generate and verify sections, and of the sort beside
+   them, set by main */
+static int section_threads ;
+static int sort_threads ;
+
+static void sort_beside_sections (uint64_t *T, const uint64_t size)
+{
+  /* runs on the sort thread: its own team size, which parallel_quicksort
+     also reads to cut its chunks */
+  omp_set_num_threads (sort_threads) ;
+  parallel_quicksort (T, size) ;
+}
+
+static void generate (uint64_t *T, const uint64_t size, uint64_t *fingerprint)
+{
+  init_array_benchmark (T, size, 0, NULL) ;
+  *fingerprint = multiset_fingerprint (T, size) ;
+}
+
+static void verify (uint64_t *T, const uint64_t size, const uint64_t fingerprint)
+{
+  if (! is_sorted (T, size))
+  {
+    fprintf (stderr, "ERROR: an array of the stream is not sorted\n") ;
+    exit (-1) ;
+  }
+  if (multiset_fingerprint (T, size) != fingerprint)
+  {
+    fprintf (stderr, "ERROR: the sort lost or duplicated elements\n") ;
+    exit (-1) ;
+  }
+}
+
+static void serial_stream (uint64_t **buffers, const uint64_t size, const uint64_t nb_arrays)
+{
+  uint64_t fingerprint ;
+  uint64_t a ;
+
+  for (a = 0; a < nb_arrays; a++)
+  {
+    generate (buffers[0], size, &fingerprint) ;
+    parallel_quicksort (buffers[0], size) ;
+    verify (buffers[0], size, fingerprint) ;
+  }
+}
+
+static uint64_t pipelined_stream (uint64_t **buffers, const uint64_t size, const uint64_t nb_arrays)
+{
+  /* returns the cycles spent in the sorts themselves */
+  uint64_t fingerprints [PIPELINE_BUFFERS] ;
+  uint64_t sort_cycles = 0 ;
+  sort_handle_t *h ;
+  uint64_t a ;
+
+  generate (buffers[0], size, &fingerprints[0]) ;
+
+  for (a = 0; a < nb_arrays; a++)
+  {
+    h = sort_submit (sort_beside_sections, buffers[a % PIPELINE_BUFFERS], size) ;
+
+    #pragma omp parallel sections num_threads(section_threads)
+    {
+      #pragma omp section
+      if (a + 1 < nb_arrays)
+        generate (buffers[(a+1) % PIPELINE_BUFFERS], size, &fingerprints[(a+1) % PIPELINE_BUFFERS]) ;
+
+      #pragma omp section
+      if (a > 0)
+        verify (buffers[(a-1) % PIPELINE_BUFFERS], size, fingerprints[(a-1) % PIPELINE_BUFFERS]) ;
+    }
+
+    sort_cycles += sort_wait (h) ;
+  }
+
+  verify (buffers[(nb_arrays-1) % PIPELINE_BUFFERS], size, fingerprints[(nb_arrays-1) % PIPELINE_BUFFERS]) ;
+  return sort_cycles ;
+}
+
+/* the state of both experiments, the arrays are made and checked inside
+   the timed part */
+typedef struct
+{
+  uint64_t **buffers ;
+  uint64_t size ;
+  uint64_t nb_arrays ;
+  uint64_t sort_cycles ;
+} stream_t ;
+
+static void run_serial (void *arg)
+{
+  stream_t *s = (stream_t *) arg ;
+
+  serial_stream (s->buffers, s->size, s->nb_arrays) ;
+}
+
+static void run_pipelined (void *arg)
+{
+  stream_t *s = (stream_t *) arg ;
+
+  s->sort_cycles += pipelined_stream (s->buffers, s->size, s->nb_arrays) ;
+}
+
+int main (int argc, char **argv)
+{
+  unsigned int b ;
+  uint64_t *buffers [PIPELINE_BUFFERS] ;
+
+  printf("================================================\n");
+  printf(" Max number of threads: %d \n", omp_get_max_threads());
+  print_tuning () ;
+
+  /* the program takes one parameter N, the arrays have size 2^N, and
+     optionally the number of arrays in the stream */
+  if (argc < 2 || argc > 3)
+  {
+      fprintf (stderr, "pipeline.run N [nb_arrays] \n") ;
+      exit (-1) ;
+  }
+
+  uint64_t N = 1UL << (atoi(argv[1])) ;
+  uint64_t nb_arrays = (argc == 3) ? strtoul (argv[2], NULL, 10) : 8 ;
+
+  if (nb_arrays == 0)
+  {
+      fprintf (stderr, "ERROR: the stream needs at least one array\n") ;
+      exit (-1) ;
+  }
+
+  for (b = 0; b < PIPELINE_BUFFERS; b++)
+  {
+    buffers[b] = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+  }
+
+  printf(" --> Sorting a stream of %lu arrays of size %lu (2^%u)\n", nb_arrays, N, atoi(argv[1]));
+  #ifdef RINIT
+    printf("--> The arrays are initialized randomly\n");
+  #endif
+
+  // Two cores for the sections when there are cores to spare for the sort
+  section_threads = (omp_get_max_threads () > 2) ? 2 : 1 ;
+  sort_threads = (omp_get_max_threads () > section_threads) ? omp_get_max_threads () - section_threads : 1 ;
+  printf(" --> Pipelined: %d thread(s) sorting, %d generating and verifying\n", sort_threads, section_threads);
+
+  stream_t stream = { buffers, N, nb_arrays, 0 } ;
+  experiment_t serial = { &stream, NULL, run_serial, NULL } ;
+  experiment_t pipelined = { &stream, NULL, run_pipelined, NULL } ;
+
+  double serial_cycles = (double)time_experiments ("serial stream", &serial)/1000000 ;
+  printf ("\n init + sort + verify \t%.2lf Mcycles\n", serial_cycles) ;
+
+  double pipelined_cycles = (double)time_experiments ("pipelined stream", &pipelined)/1000000 ;
+  double sort_only = (double)stream.sort_cycles/NBEXPERIMENTS/1000000 ;
+  printf (" pipelined \t\t%.2lf Mcycles\n", pipelined_cycles) ;
+  printf (" sorts alone \t\t%.2lf Mcycles\n\n", sort_only) ;
+
+  printf (" Throughput: \t\t%.1lf arrays/s serial, %.1lf arrays/s pipelined\n",
+          nb_arrays / (serial_cycles * 1e6 / tsc_frequency ()),
+          nb_arrays / (pipelined_cycles * 1e6 / tsc_frequency ())) ;
+  printf (" Speedup: \t\t%f\n", serial_cycles/pipelined_cycles) ;
+
+  for (b = 0; b < PIPELINE_BUFFERS; b++)
+  {
+    arena_release (buffers[b]) ;
+  }
+
+  printf("================================================\n\n");
+}
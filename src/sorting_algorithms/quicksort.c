@@ -1,128 +1,22 @@
 #include <stdio.h>
 #include <omp.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
-#include <x86intrin.h>
-
 #include "sorting.h"
 
 
-int compare_function(const void *x, const void *y)
-{
-  /* Compare function for qsort() */
-
-  return (*(uint64_t*)x - *(uint64_t*)y);
-}
-
-
-/* 
-   Merge two sorted chunks of array T!
-   The two chunks are of size size
-   First chunck starts at T[0], second chunck starts at T[size]
-*/
-void merge (uint64_t *T, const uint64_t size)
-{
-  uint64_t *X = (uint64_t *) malloc (2 * size * sizeof(uint64_t)) ;
-  
-  uint64_t i = 0 ;
-  uint64_t j = size ;
-  uint64_t k = 0 ;
-  
-  while ((i < size) && (j < 2*size))
-  {
-    if (T[i] < T [j])
-	  {
-      X [k] = T [i] ;
-      i = i + 1 ;
-	  }
-    else
-    {
-      X [k] = T [j] ;
-      j = j + 1 ;
-    }
-    k = k + 1 ;
-  }
-
-  if (i < size)
-  {
-    for (; i < size; i++, k++)
-    {
-      X [k] = T [i] ;
-    }
-  }
-  else
-  {
-    for (; j < 2*size; j++, k++)
-    {
-      X [k] = T [j] ;
-    }
-  }
-  
-  memcpy (T, X, 2*size*sizeof(uint64_t)) ;
-  free (X) ;
-  
-  return ;
-}
-
-// ------------------------------------------------
-
-/* 
-   quick sort -- sequential, parallel -- 
-*/
-
-void sequential_quicksort(uint64_t *T, const uint64_t size)
-{
-  // Just calls the built-in qsort function
-  qsort(T, size, sizeof(uint64_t), compare_function);
-  return;
-}
-
-void parallel_quicksort(uint64_t *T, const uint64_t size)
-{
-  uint64_t chunk_size, trim_size;
-  uint64_t i;
-
-  chunk_size = size/omp_get_max_threads();
-
-  #pragma omp parallel for schedule(static)
-    for (i = 0; i < size; i+=chunk_size)
-    {
-      sequential_quicksort(T+i, chunk_size);
-    }
-  // printf("After seq sorting:\n");
-  // print_array(T, size);
-
-  // The outer loop keeps on doubling the size of chunk (`trim_size`),
-  // which is taken for merging
-  for (trim_size = chunk_size; trim_size <= size/2; trim_size+=trim_size)
-  {
-    // Merge 2 consecutive chunks for whole array
-    #pragma omp parallel for schedule(static), shared(T, i, trim_size)
-      for (i = 0; i < size; i+=2*trim_size)
-      {
-        merge(T+i, trim_size);
-      }
-    
-  }
-  
-  // printf("After merging:\n");
-  // print_array(T, size);
-
-  return;
-
-}
-
-
-
 int main (int argc, char **argv)
 {
-  uint64_t start, end;
   uint64_t av ;
-  unsigned int exp ;
+  uint64_t bytes, passes ;
+  mem_counters_t counters ;
 
   printf("================================================\n");
   printf(" Max number of threads: %d \n", omp_get_max_threads());
+  print_tuning () ;
+  printf(" Merge kernel: %s \n", merge_kernel_name());
 
   /* the program takes one parameter N which is the size of the array to
       be sorted. The array will have size 2^N */
@@ -134,7 +28,7 @@ int main (int argc, char **argv)
 
   uint64_t N = 1 << (atoi(argv[1])) ;
   /* the array to be sorted */
-  uint64_t *X = (uint64_t *) malloc (N * sizeof(uint64_t)) ;
+  uint64_t *X = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
 
   printf(" --> Sorting an array of size %lu (2^%u)\n", N, atoi(argv[1]));
   #ifdef RINIT
@@ -142,93 +36,44 @@ int main (int argc, char **argv)
   #endif
   
 
-  for (exp = 0 ; exp < NBEXPERIMENTS; exp++)
-  {
-      #ifdef RINIT
-          init_array_random (X, N);
-      #else
-          init_array_sequence (X, N);
-      #endif
-          
-      
-      start = _rdtsc () ;
-      
-      sequential_quicksort (X, N) ;
-      
-      end = _rdtsc () ;
-      experiments [exp] = end - start ;
-
-      /* verifying that X is properly sorted */
-      #ifdef RINIT
-      if (! is_sorted (X, N))
-      {
-          fprintf(stderr, "ERROR: the sequential sorting of the array failed\n") ;
-          print_array (X, N) ;
-          exit (-1) ;
-      }
-      #else
-      if (! is_sorted_sequence (X, N))
-      {
-          fprintf(stderr, "ERROR: the sequential sorting of the array failed\n") ;
-          print_array (X, N) ;
-          exit (-1) ;
-      }
-      #endif
-  }
-
-  av = average_time() ;  
+  mem_counters_start (&counters) ;
+  av = time_sort_experiments ("quicksort serial", sequential_quicksort, X, N, init_array_benchmark, NULL) ;
+  mem_counters_stop (&counters) ;
 
   double serial_cycles = (double)av/1000000;
   printf ("\n Quicksort serial \t%.2lf Mcycles\n\n", serial_cycles) ;
+  print_mem_counters ("serial", &counters) ;
+  write_mem_counters_csv ("quicksort", "serial", N, av, &counters) ;
+  bytes = quicksort_traffic (N, 1, &passes) ;
+  print_bandwidth ("serial", bytes, passes, av) ;
 
 
-  for (exp = 0 ; exp < NBEXPERIMENTS; exp++)
-  {
-      #ifdef RINIT
-              init_array_random (X, N);
-      #else
-              init_array_sequence (X, N);
-      #endif
-      
-      start = _rdtsc () ;
-      
-      parallel_quicksort (X, N) ;
-        
-      end = _rdtsc () ;
-      experiments [exp] = end - start ;
+  mem_counters_start (&counters) ;
+  av = time_sort_experiments ("quicksort parallel", parallel_quicksort, X, N, init_array_benchmark, NULL) ;
+  mem_counters_stop (&counters) ;
 
-      /* verifying that X is properly sorted */
-      #ifdef RINIT
-      if (! is_sorted (X, N))
-      {
-          fprintf(stderr, "ERROR: the parallel sorting of the array failed\n") ;
-          exit (-1) ;
-    }
-      #else
-      if (! is_sorted_sequence (X, N))
-      {
-          fprintf(stderr, "ERROR: the parallel sorting of the array failed\n") ;
-          print_array (X, N);
-          exit (-1) ;
-      }
-      #endif
-              
-  }
-  
-  av = average_time() ;  
   double parallel_cycles = (double)av/1000000;
   printf (" Quicksort parallel \t%.2lf Mcycles\n\n", (double)av/1000000) ;
+  print_mem_counters ("parallel", &counters) ;
+  write_mem_counters_csv ("quicksort", "parallel", N, av, &counters) ;
+  bytes = quicksort_traffic (N, (N <= tuning.sequential_cutoff) ? 1 : omp_get_max_threads () * tuning.chunks_per_thread,
+                             &passes) ;
+  print_bandwidth ("parallel", bytes, passes, av) ;
   
   FILE *f = fopen("speedups.txt", "a+w");
 
   printf(" Speedup: \t\t%f\n", serial_cycles/parallel_cycles);
   fprintf(f, "%f\n", serial_cycles/parallel_cycles);
 
+  const char *variants [] = { "quicksort serial", "quicksort parallel" } ;
+  double variant_cycles [] = { serial_cycles, parallel_cycles } ;
+  report_baselines (init_array_benchmark, NULL, N, variants, variant_cycles, 2) ;
+
   /* print_array (X, N) ; */
 
   /* before terminating, we run one extra test of the algorithm */
-  uint64_t *Y = (uint64_t *) malloc (N * sizeof(uint64_t)) ;
-  uint64_t *Z = (uint64_t *) malloc (N * sizeof(uint64_t)) ;
+  uint64_t *Y = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+  uint64_t *Z = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
 
   #ifdef RINIT
       init_array_random (Y, N);
@@ -247,9 +92,9 @@ int main (int argc, char **argv)
   }
 
 
-  free(X);
-  free(Y);
-  free(Z);
+  arena_release(X);
+  arena_release(Y);
+  arena_release(Z);
 
   printf("================================================\n\n");
     
@@ -0,0 +1,386 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <x86intrin.h>
+
+#include "sorting.h"
+
+/*
+   regress -- performance regression gate --
+
+       regress.run record [baseline]   time the matrix, write the baseline
+       regress.run check [baseline]    time it again, compare
+
+   Every entry of the matrix below (kernel x size) is timed NBEXPERIMENTS
+   times on the same pseudo random input. The baseline file keeps all the
+   samples, not only the average, so that check can test whether the new
+   samples are really larger: an entry is a regression when its median is
+   more than REGRESS_THRESHOLD percent (environment, default 25) above
+   the baseline median and the one-sided Mann-Whitney U test rejects "not
+   slower" at REGRESS_ALPHA. check prints a table of every entry and exits
+   with 1 when something regressed.
+
+   The baseline only means something on the machine (and number of
+   threads) it was recorded on: record it again after changing either.
+   Every entry carries its thread count; check only compares entries of
+   the current one, and record replaces them, keeping the others.
+*/
+
+#define DEFAULT_BASELINE "regress_baseline.txt"
+#define DEFAULT_THRESHOLD 25.0
+#define REGRESS_ALPHA 0.01
+
+typedef struct
+{
+  const char *name ;
+  sort_t sort ;
+  uint64_t size ;
+  int sorted_halves ;   /* input is two sorted halves (merge kernels) */
+  int check_sorted ;
+} entry_t ;
+
+typedef struct
+{
+  char name [64] ;
+  uint64_t size ;
+  int threads ;
+  uint64_t samples [NBEXPERIMENTS] ;
+} result_t ;
+
+
+static void merge_sort_in_region (uint64_t *T, const uint64_t size)
+{
+  #pragma omp parallel
+  {
+    #pragma omp single
+    parallel_merge_sort (T, size) ;
+  }
+}
+
+static void merge_halves (uint64_t *T, const uint64_t size)
+{
+  merge (T, size / 2) ;
+}
+
+static void parallel_merge_halves (uint64_t *T, const uint64_t size)
+{
+  uint64_t *S = arena_scratch (size) ;
+
+  parallel_merge_runs (S, T, size / 2, T + size / 2, size - size / 2) ;
+  memcpy (T, S, size * sizeof(uint64_t)) ;
+}
+
+static void select_median (uint64_t *T, const uint64_t size)
+{
+  parallel_select (T, size, size / 2) ;
+}
+
+static const entry_t matrix [] =
+{
+  { "sequential_quicksort",   sequential_quicksort,   1 << 16, 0, 1 },
+  { "sequential_quicksort",   sequential_quicksort,   1 << 20, 0, 1 },
+  { "parallel_quicksort",     parallel_quicksort,     1 << 16, 0, 1 },
+  { "parallel_quicksort",     parallel_quicksort,     1 << 20, 0, 1 },
+  { "sequential_merge_sort",  sequential_merge_sort,  1 << 16, 0, 1 },
+  { "sequential_merge_sort",  sequential_merge_sort,  1 << 20, 0, 1 },
+  { "parallel_merge_sort",    merge_sort_in_region,   1 << 16, 0, 1 },
+  { "parallel_merge_sort",    merge_sort_in_region,   1 << 20, 0, 1 },
+  { "merge",                  merge_halves,           1 << 20, 1, 1 },
+  { "parallel_merge_runs",    parallel_merge_halves,  1 << 20, 1, 1 },
+  { "small_array_sort",       small_array_sort,       1 << 10, 0, 1 },
+  { "parallel_select",        select_median,          1 << 20, 0, 0 },
+} ;
+
+#define MATRIX_SIZE (sizeof(matrix) / sizeof(matrix[0]))
+
+/* entries kept in a baseline file, for all the thread counts */
+#define MAX_BASELINE (16 * MATRIX_SIZE)
+
+
+static void init_input (uint64_t *R, const entry_t *e)
+{
+  /* xorshift with a fixed seed: the same input on every run */
+  uint64_t state = 0x9e3779b97f4a7c15ULL ;
+  uint64_t i ;
+
+  for (i = 0; i < e->size; i++)
+  {
+    state ^= state << 13 ;
+    state ^= state >> 7 ;
+    state ^= state << 17 ;
+    R[i] = state % e->size ;
+  }
+
+  if (e->sorted_halves)
+  {
+    sequential_quicksort (R, e->size / 2) ;
+    sequential_quicksort (R + e->size / 2, e->size - e->size / 2) ;
+  }
+}
+
+static void run_matrix (result_t *results)
+{
+  uint64_t start, end ;
+  unsigned int i, exp ;
+
+  for (i = 0; i < MATRIX_SIZE; i++)
+  {
+    const entry_t *e = &matrix[i] ;
+    uint64_t *R = (uint64_t *) arena_alloc (e->size * sizeof(uint64_t)) ;
+    uint64_t *X = (uint64_t *) arena_alloc (e->size * sizeof(uint64_t)) ;
+
+    init_input (R, e) ;
+
+    // One untimed run to fault in the buffers and the scratch space
+    memcpy (X, R, e->size * sizeof(uint64_t)) ;
+    e->sort (X, e->size) ;
+
+    for (exp = 0 ; exp < NBEXPERIMENTS; exp++)
+    {
+      memcpy (X, R, e->size * sizeof(uint64_t)) ;
+
+      start = _rdtsc () ;
+      e->sort (X, e->size) ;
+      end = _rdtsc () ;
+      results[i].samples[exp] = end - start ;
+
+      if (e->check_sorted && ! is_sorted (X, e->size))
+      {
+        fprintf (stderr, "ERROR: %s failed on %lu keys\n", e->name, e->size) ;
+        exit (-1) ;
+      }
+    }
+
+    snprintf (results[i].name, sizeof(results[i].name), "%s", e->name) ;
+    results[i].size = e->size ;
+    results[i].threads = omp_get_max_threads () ;
+
+    arena_release (R) ;
+    arena_release (X) ;
+  }
+}
+
+static int compare_samples (const void *x, const void *y)
+{
+  uint64_t a = *(const uint64_t *) x ;
+  uint64_t b = *(const uint64_t *) y ;
+
+  return (a > b) - (a < b) ;
+}
+
+static double median (const uint64_t *samples)
+{
+  uint64_t s [NBEXPERIMENTS] ;
+
+  memcpy (s, samples, sizeof(s)) ;
+  qsort (s, NBEXPERIMENTS, sizeof(uint64_t), compare_samples) ;
+
+  return (NBEXPERIMENTS % 2) ? (double)s[NBEXPERIMENTS/2]
+                             : ((double)s[NBEXPERIMENTS/2 - 1] + s[NBEXPERIMENTS/2]) / 2 ;
+}
+
+static double mann_whitney_slower (const uint64_t *current, const uint64_t *baseline)
+{
+  /* one-sided p-value of "current is not slower than baseline": U counts
+     the (current, baseline) pairs where current is larger, ties count
+     half; normal approximation with continuity correction */
+  const double n = NBEXPERIMENTS ;
+  double u = 0, mean, sd, z ;
+  unsigned int i, j ;
+
+  for (i = 0; i < NBEXPERIMENTS; i++)
+  {
+    for (j = 0; j < NBEXPERIMENTS; j++)
+    {
+      u += (current[i] > baseline[j]) + 0.5 * (current[i] == baseline[j]) ;
+    }
+  }
+
+  mean = n * n / 2 ;
+  sd = sqrt (n * n * (2 * n + 1) / 12) ;
+  z = (u - mean - 0.5) / sd ;
+
+  return 0.5 * erfc (z / sqrt (2)) ;
+}
+
+static void save_entry (FILE *f, const result_t *r)
+{
+  unsigned int exp ;
+
+  fprintf (f, "%s %lu %d", r->name, r->size, r->threads) ;
+  for (exp = 0; exp < NBEXPERIMENTS; exp++)
+  {
+    fprintf (f, " %lu", r->samples[exp]) ;
+  }
+  fprintf (f, "\n") ;
+}
+
+static int save_baseline (const char *path, const result_t *results,
+                          const result_t *baseline, const unsigned int count)
+{
+  /* the entries of the other thread counts stay, those of this one are
+     replaced by results */
+  FILE *f = fopen (path, "w") ;
+  unsigned int i ;
+
+  if (f == NULL)
+    return -1 ;
+
+  fprintf (f, "# written by regress.run record: kernel size threads, then %d samples in cycles\n",
+           NBEXPERIMENTS) ;
+  for (i = 0; i < count; i++)
+  {
+    if (baseline[i].threads != results[0].threads)
+      save_entry (f, &baseline[i]) ;
+  }
+  for (i = 0; i < MATRIX_SIZE; i++)
+  {
+    save_entry (f, &results[i]) ;
+  }
+  fclose (f) ;
+
+  return 0 ;
+}
+
+static int load_baseline (const char *path, result_t *baseline, unsigned int *count)
+{
+  FILE *f = fopen (path, "r") ;
+  char line [1024] ;
+  result_t *r ;
+  int offset, used, exp ;
+
+  *count = 0 ;
+  if (f == NULL)
+    return -1 ;
+
+  while (fgets (line, sizeof(line), f) != NULL && *count < MAX_BASELINE)
+  {
+    if (line[0] == '#')
+      continue ;
+
+    r = &baseline[*count] ;
+    if (sscanf (line, "%63s %lu %d%n", r->name, &r->size, &r->threads, &offset) != 3)
+      continue ;
+    for (exp = 0; exp < NBEXPERIMENTS; exp++)
+    {
+      if (sscanf (line + offset, " %lu%n", &r->samples[exp], &used) != 1)
+        break ;
+      offset += used ;
+    }
+    if (exp == NBEXPERIMENTS)
+      *count = *count + 1 ;
+  }
+  fclose (f) ;
+
+  return 0 ;
+}
+
+static int check (const result_t *results, const result_t *baseline, const unsigned int count,
+                  const double threshold)
+{
+  unsigned int i, b ;
+  int regressions = 0 ;
+  double before, after, change, p ;
+  const char *status ;
+
+  printf (" %-24s %9s %14s %14s %9s %8s\n", "kernel", "size", "baseline Mc", "current Mc", "change", "p") ;
+  for (i = 0; i < MATRIX_SIZE; i++)
+  {
+    for (b = 0; b < count; b++)
+    {
+      if (strcmp (baseline[b].name, results[i].name) == 0 && baseline[b].size == results[i].size
+          && baseline[b].threads == results[i].threads)
+        break ;
+    }
+    if (b == count)
+    {
+      printf (" %-24s %9lu %14s %14.3lf %9s %8s   new\n", results[i].name, results[i].size,
+              "-", median (results[i].samples)/1000000, "-", "-") ;
+      continue ;
+    }
+
+    before = median (baseline[b].samples) ;
+    after = median (results[i].samples) ;
+    change = 100.0 * (after - before) / before ;
+    p = mann_whitney_slower (results[i].samples, baseline[b].samples) ;
+
+    if (change > threshold && p < REGRESS_ALPHA)
+    {
+      status = "SLOWER" ;
+      regressions++ ;
+    }
+    else if (change < -threshold && 1 - p < REGRESS_ALPHA)
+      status = "faster" ;
+    else
+      status = "ok" ;
+
+    printf (" %-24s %9lu %14.3lf %14.3lf %+8.1lf%% %8.4lf   %s\n", results[i].name, results[i].size,
+            before/1000000, after/1000000, change, p, status) ;
+  }
+
+  return regressions ;
+}
+
+int main (int argc, char **argv)
+{
+  result_t results [MATRIX_SIZE] ;
+  result_t baseline [MAX_BASELINE] ;
+  unsigned int count = 0, b ;
+  int regressions ;
+  const char *env = getenv ("REGRESS_THRESHOLD") ;
+  double threshold = (env != NULL) ? atof (env) : DEFAULT_THRESHOLD ;
+
+  if (argc < 2 || argc > 3 || (strcmp (argv[1], "record") != 0 && strcmp (argv[1], "check") != 0))
+  {
+      fprintf (stderr, "regress.run record|check [baseline] \n") ;
+      exit (-1) ;
+  }
+  const char *path = (argc == 3) ? argv[2] : DEFAULT_BASELINE ;
+
+  printf("================================================\n");
+  printf(" Max number of threads: %d \n", omp_get_max_threads());
+  print_tuning () ;
+  printf(" Merge kernel: %s \n", merge_kernel_name());
+
+  // record keeps the entries of the other thread counts, if any
+  if (load_baseline (path, baseline, &count) != 0 && strcmp (argv[1], "check") == 0)
+  {
+      fprintf (stderr, "ERROR: cannot read %s, run regress.run record first\n", path) ;
+      exit (-1) ;
+  }
+
+  printf(" --> Timing %lu entries, %d samples each\n\n", MATRIX_SIZE, NBEXPERIMENTS);
+  run_matrix (results) ;
+
+  if (strcmp (argv[1], "record") == 0)
+  {
+    if (save_baseline (path, results, baseline, count) != 0)
+    {
+        fprintf (stderr, "ERROR: cannot write %s\n", path) ;
+        exit (-1) ;
+    }
+    printf (" Baseline written to %s\n", path) ;
+    printf("================================================\n\n");
+    return 0 ;
+  }
+
+  for (b = 0; b < count && baseline[b].threads != omp_get_max_threads (); b++)
+    ;
+  if (b == count)
+    printf (" WARNING: %s has no entry recorded with %d threads\n\n", path, omp_get_max_threads ()) ;
+
+  regressions = check (results, baseline, count, threshold) ;
+
+  if (regressions > 0)
+    printf ("\n REGRESSION: %d entries slower by more than %.1lf%% (p < %.2lf) than %s\n",
+            regressions, threshold, REGRESS_ALPHA, path) ;
+  else
+    printf ("\n No regression against %s (threshold %.1lf%%)\n", path, threshold) ;
+
+  printf("================================================\n\n");
+  return (regressions > 0) ? 1 : 0 ;
+}
@@ -0,0 +1,375 @@
+#include <stdio.h>
+#include <omp.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <mpi.h>
+#include <x86intrin.h>
+
+#include "sorting.h"
+
+/*
+   sample sort -- distributed over MPI ranks, OpenMP inside each rank --
+
+   1. every rank sorts its keys with parallel_quicksort
+   2. every rank takes regularly spaced samples, they are gathered on all
+      ranks and p-1 splitters are chosen among them
+   3. the keys are exchanged so that rank r gets the keys between
+      splitters r-1 and r (all-to-all)
+   4. the p sorted runs received are merged with parallel_merge_runs
+   5. optionally the keys are moved again so that every rank holds
+      exactly N/p of them (rebalance)
+
+   The counts and displacements of MPI_Alltoallv are int: a rank cannot
+   send or receive more than INT_MAX keys in one exchange, the program
+   stops with a message when it would (use more ranks).
+
+   Usage: mpirun -np P ./samplesort_mpi.run N [rebalance]
+*/
+
+/* samples per rank and per splitter */
+#define OVERSAMPLING 16
+
+typedef struct
+{
+  uint64_t compute ;
+  uint64_t communication ;
+} phase_times_t ;
+
+
+static int nb_ranks ;
+static int rank ;
+
+
+static void init_local_keys (uint64_t *T, const uint64_t n, const uint64_t offset, const uint64_t N)
+{
+  /* the part [offset, offset+n) of the array the sequential programs sort */
+  uint64_t i ;
+
+  #ifdef RINIT
+    srand (time (NULL) ^ (rank * 7919)) ;
+    for (i = 0 ; i < n ; i++)
+    {
+      T [i] = rand() % N ;
+    }
+  #else
+    for (i = 0 ; i < n ; i++)
+    {
+      T [i] = N - (offset + i) ;
+    }
+  #endif
+}
+
+static int to_count (const uint64_t keys, const char *what)
+{
+  /* keys as a count or displacement of MPI_Alltoallv */
+  if (keys > INT_MAX)
+  {
+    fprintf (stderr, "ERROR: rank %d would %s %lu keys, more than the %d of an MPI int count\n",
+             rank, what, keys, INT_MAX) ;
+    MPI_Abort (MPI_COMM_WORLD, -1) ;
+  }
+  return (int) keys ;
+}
+
+static uint64_t *merge_received_runs (uint64_t *R, uint64_t *S, const int *displs, const int *counts)
+{
+  /* p sorted runs stored back to back in R, merged pairwise; returns the
+     buffer (R or S) holding the result */
+  int width, i, j, k ;
+  uint64_t lo, mid, hi ;
+  uint64_t *swap ;
+
+  for (width = 1; width < nb_ranks; width += width)
+  {
+    for (i = 0; i < nb_ranks; i += 2*width)
+    {
+      j = (i + width < nb_ranks) ? i + width : nb_ranks ;
+      k = (i + 2*width < nb_ranks) ? i + 2*width : nb_ranks ;
+      lo = displs[i] ;
+      mid = (j < nb_ranks) ? (uint64_t) displs[j] : (uint64_t) displs[nb_ranks-1] + counts[nb_ranks-1] ;
+      hi = (k < nb_ranks) ? (uint64_t) displs[k] : (uint64_t) displs[nb_ranks-1] + counts[nb_ranks-1] ;
+      parallel_merge_runs (S + lo, R + lo, mid - lo, R + mid, hi - mid) ;
+    }
+    swap = R ;
+    R = S ;
+    S = swap ;
+  }
+  return R ;
+}
+
+static uint64_t *exchange (uint64_t *send, const int *send_counts, int *recv_counts, int *recv_displs,
+                           uint64_t *total)
+{
+  /* all-to-all of send_counts[r] keys to every rank r; returns the
+     received keys (malloc'ed), stored by sending rank */
+  int *send_displs = (int *) malloc (nb_ranks * sizeof(int)) ;
+  uint64_t *recv ;
+  uint64_t sent = 0, received = 0 ;
+  int r ;
+
+  MPI_Alltoall (send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, MPI_COMM_WORLD) ;
+
+  // The displacements are summed in 64 bits, they must fit in an int
+  for (r = 0; r < nb_ranks; r++)
+  {
+    send_displs[r] = to_count (sent, "send") ;
+    recv_displs[r] = to_count (received, "receive") ;
+    sent += send_counts[r] ;
+    received += recv_counts[r] ;
+  }
+  to_count (sent, "send") ;
+  *total = to_count (received, "receive") ;
+  recv = (uint64_t *) malloc ((*total + 1) * sizeof(uint64_t)) ;
+
+  MPI_Alltoallv (send, send_counts, send_displs, MPI_UINT64_T,
+                 recv, recv_counts, recv_displs, MPI_UINT64_T, MPI_COMM_WORLD) ;
+
+  free (send_displs) ;
+  return recv ;
+}
+
+/*
+   Sort the n keys of T across all ranks. On return *result holds the
+   local part of the sorted array (*result_size keys, allocated with
+   malloc) and all keys of rank r are <= all keys of rank r+1.
+*/
+static void sample_sort (uint64_t *T, const uint64_t n, const uint64_t N, const int rebalance,
+                         uint64_t **result, uint64_t *result_size, phase_times_t *times)
+{
+  uint64_t t0 ;
+  uint64_t i, total, g0, lo, hi ;
+  int r ;
+  int nb_samples = OVERSAMPLING * nb_ranks ;
+  uint64_t *samples = (uint64_t *) malloc (nb_samples * sizeof(uint64_t)) ;
+  uint64_t *all_samples = (uint64_t *) malloc (nb_samples * nb_ranks * sizeof(uint64_t)) ;
+  uint64_t *splitters = (uint64_t *) malloc (nb_ranks * sizeof(uint64_t)) ;
+  int *send_counts = (int *) malloc (nb_ranks * sizeof(int)) ;
+  int *recv_counts = (int *) malloc (nb_ranks * sizeof(int)) ;
+  int *recv_displs = (int *) malloc (nb_ranks * sizeof(int)) ;
+  uint64_t *R, *S, *sorted ;
+
+  times->compute = 0 ;
+  times->communication = 0 ;
+
+  // 1. local sort
+  t0 = _rdtsc () ;
+  parallel_quicksort (T, n) ;
+
+  for (i = 0; i < (uint64_t) nb_samples; i++)
+  {
+    samples[i] = (n > 0) ? T[i * n / nb_samples] : UINT64_MAX ;
+  }
+  times->compute += _rdtsc () - t0 ;
+
+  // 2. splitters
+  t0 = _rdtsc () ;
+  MPI_Allgather (samples, nb_samples, MPI_UINT64_T, all_samples, nb_samples, MPI_UINT64_T, MPI_COMM_WORLD) ;
+  times->communication += _rdtsc () - t0 ;
+
+  t0 = _rdtsc () ;
+  sequential_quicksort (all_samples, (uint64_t) nb_samples * nb_ranks) ;
+  for (r = 0; r < nb_ranks - 1; r++)
+  {
+    splitters[r] = all_samples[(uint64_t) (r + 1) * nb_samples] ;
+  }
+
+  // Keys < splitters[r] (and >= splitters[r-1]) go to rank r
+  lo = 0 ;
+  for (r = 0; r < nb_ranks; r++)
+  {
+    hi = lo ;
+    if (r == nb_ranks - 1)
+      hi = n ;
+    else
+      while (hi < n && T[hi] < splitters[r]) hi++ ;
+    send_counts[r] = to_count (hi - lo, "send") ;
+    lo = hi ;
+  }
+  times->compute += _rdtsc () - t0 ;
+
+  // 3. all-to-all exchange
+  t0 = _rdtsc () ;
+  R = exchange (T, send_counts, recv_counts, recv_displs, &total) ;
+  S = (uint64_t *) malloc ((total + 1) * sizeof(uint64_t)) ;
+  times->communication += _rdtsc () - t0 ;
+
+  // 4. merge of the sorted runs
+  t0 = _rdtsc () ;
+  sorted = merge_received_runs (R, S, recv_displs, recv_counts) ;
+  if (sorted == R)
+  {
+    free (S) ;
+  }
+  else
+  {
+    free (R) ;
+  }
+  times->compute += _rdtsc () - t0 ;
+
+  // 5. rebalance: rank r gets the keys of global rank [r*N/p, (r+1)*N/p)
+  if (rebalance)
+  {
+    t0 = _rdtsc () ;
+    g0 = 0 ;
+    MPI_Exscan (&total, &g0, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD) ;
+    if (rank == 0)
+      g0 = 0 ;
+
+    for (r = 0; r < nb_ranks; r++)
+    {
+      lo = (uint64_t) r * N / nb_ranks ;
+      hi = (uint64_t) (r + 1) * N / nb_ranks ;
+      lo = (lo > g0) ? lo : g0 ;
+      hi = (hi < g0 + total) ? hi : g0 + total ;
+      send_counts[r] = to_count ((hi > lo) ? hi - lo : 0, "send") ;
+    }
+
+    R = exchange (sorted, send_counts, recv_counts, recv_displs, &total) ;
+    free (sorted) ;
+    sorted = R ;
+    times->communication += _rdtsc () - t0 ;
+  }
+
+  *result = sorted ;
+  *result_size = total ;
+
+  free (samples) ;
+  free (all_samples) ;
+  free (splitters) ;
+  free (send_counts) ;
+  free (recv_counts) ;
+  free (recv_displs) ;
+}
+
+/* 1 if the local part is sorted and follows the part of the previous rank */
+static int globally_sorted (uint64_t *T, const uint64_t n)
+{
+  uint64_t last = (n > 0) ? T[n-1] : 0 ;
+  uint64_t previous_last = 0 ;
+  uint64_t has_keys = n > 0 ;
+  uint64_t previous_has_keys = 0 ;
+  int ok, all_ok ;
+  uint64_t msg [2], prev [2] ;
+
+  /* ranks without keys pass on what they received */
+  msg[0] = last ;
+  msg[1] = has_keys ;
+  prev[0] = 0 ;
+  prev[1] = 0 ;
+  if (rank > 0)
+  {
+    MPI_Recv (prev, 2, MPI_UINT64_T, rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE) ;
+    previous_last = prev[0] ;
+    previous_has_keys = prev[1] ;
+    if (! has_keys)
+    {
+      msg[0] = previous_last ;
+      msg[1] = previous_has_keys ;
+    }
+  }
+  if (rank < nb_ranks - 1)
+  {
+    MPI_Send (msg, 2, MPI_UINT64_T, rank + 1, 0, MPI_COMM_WORLD) ;
+  }
+
+  ok = is_sorted (T, n) && ! (previous_has_keys && has_keys && previous_last > T[0]) ;
+  MPI_Allreduce (&ok, &all_ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD) ;
+  return all_ok ;
+}
+
+int main (int argc, char **argv)
+{
+  uint64_t start, end;
+  unsigned int exp ;
+  uint64_t fingerprint, global_fingerprint, result_fingerprint, count ;
+  uint64_t compute_max, communication_max, total_max, elapsed ;
+  uint64_t compute_sum = 0, communication_sum = 0 ;
+  uint64_t *result, result_size ;
+  phase_times_t times ;
+
+  MPI_Init (&argc, &argv) ;
+  MPI_Comm_size (MPI_COMM_WORLD, &nb_ranks) ;
+  MPI_Comm_rank (MPI_COMM_WORLD, &rank) ;
+
+  /* the program takes one parameter N, the total size of the array to be
+     sorted is 2^N, and optionally "rebalance" */
+  if (argc != 2 && !(argc == 3 && strcmp (argv[2], "rebalance") == 0))
+  {
+      if (rank == 0)
+          fprintf (stderr, "mpirun -np P samplesort_mpi.run N [rebalance] \n") ;
+      MPI_Finalize () ;
+      exit (-1) ;
+  }
+
+  int rebalance = (argc == 3) ;
+  uint64_t N = 1UL << (atoi(argv[1])) ;
+  uint64_t offset = (uint64_t) rank * N / nb_ranks ;
+  uint64_t n = (uint64_t) (rank + 1) * N / nb_ranks - offset ;
+  uint64_t *X = (uint64_t *) arena_alloc ((n + 1) * sizeof(uint64_t)) ;
+
+  if (rank == 0)
+  {
+      printf("================================================\n");
+      printf(" MPI ranks: %d, threads per rank: %d \n", nb_ranks, omp_get_max_threads());
+      printf(" --> Sorting an array of size %lu (2^%u)%s\n", N, atoi(argv[1]),
+             rebalance ? ", rebalanced" : "");
+      #ifdef RINIT
+        printf("--> The array is initialized randomly\n");
+      #endif
+  }
+
+  for (exp = 0 ; exp < NBEXPERIMENTS; exp++)
+  {
+      init_local_keys (X, n, offset, N) ;
+
+      fingerprint = multiset_fingerprint (X, n) ;
+      MPI_Allreduce (&fingerprint, &global_fingerprint, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD) ;
+
+      MPI_Barrier (MPI_COMM_WORLD) ;
+      start = _rdtsc () ;
+
+      sample_sort (X, n, N, rebalance, &result, &result_size, &times) ;
+
+      end = _rdtsc () ;
+      elapsed = end - start ;
+      MPI_Allreduce (&elapsed, &total_max, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD) ;
+      MPI_Allreduce (&times.compute, &compute_max, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD) ;
+      MPI_Allreduce (&times.communication, &communication_max, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD) ;
+      experiments [exp] = total_max ;
+      compute_sum += compute_max ;
+      communication_sum += communication_max ;
+
+      /* verifying that the keys are sorted across ranks, none lost or
+         duplicated: the fingerprint of a multiset is the sum of the
+         fingerprints of its parts */
+      fingerprint = multiset_fingerprint (result, result_size) ;
+      MPI_Allreduce (&fingerprint, &result_fingerprint, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD) ;
+      MPI_Allreduce (&result_size, &count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD) ;
+
+      if (! globally_sorted (result, result_size) || count != N || result_fingerprint != global_fingerprint
+          || (rebalance && result_size != n))
+      {
+          if (rank == 0)
+              fprintf(stderr, "ERROR: the distributed sorting of the array failed\n") ;
+          MPI_Abort (MPI_COMM_WORLD, -1) ;
+      }
+
+      free (result) ;
+  }
+
+  if (rank == 0)
+  {
+      printf ("\n sample sort total \t%.2lf Mcycles\n", (double)average_time()/1000000) ;
+      printf (" compute (max rank) \t%.2lf Mcycles\n", (double)compute_sum/NBEXPERIMENTS/1000000) ;
+      printf (" communication (max) \t%.2lf Mcycles\n\n", (double)communication_sum/NBEXPERIMENTS/1000000) ;
+      printf("================================================\n\n");
+  }
+
+  arena_release (X) ;
+  MPI_Finalize () ;
+  return 0 ;
+}
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   segmented sort -- many small independent arrays in one call --
+
+   The segments are stored back to back in T, segment s being
+   T[offsets[s]..offsets[s+1]). They are handed out to the threads of a
+   single parallel region largest first, so the big segments do not end
+   up last on a busy thread, and each one is sorted by a sequential
+   kernel tuned for small arrays.
+*/
+
+/* runs of this size are sorted by insertion before merging */
+#define SMALL_SORT_RUN 16
+
+typedef struct
+{
+  uint64_t size ;
+  uint64_t index ;
+} segment_t ;
+
+
+void small_array_sort (uint64_t *T, const uint64_t size)
+{
+  /* insertion sorted runs, then bottom-up merge passes that go back and
+     forth between T and the per-thread scratch buffer */
+  uint64_t *src, *dst, *swap ;
+  uint64_t i, m, e, w ;
+
+  for (i = 0; i < size; i += SMALL_SORT_RUN)
+  {
+    insertion_sort (T + i, (size - i < SMALL_SORT_RUN) ? size - i : SMALL_SORT_RUN) ;
+  }
+  if (size <= SMALL_SORT_RUN)
+    return ;
+
+  src = T ;
+  dst = arena_scratch (size) ;
+
+  for (w = SMALL_SORT_RUN; w < size; w += w)
+  {
+    for (i = 0; i < size; i += 2*w)
+    {
+      m = (i + w < size) ? i + w : size ;
+      e = (i + 2*w < size) ? i + 2*w : size ;
+      merge_runs (dst + i, src + i, m - i, src + m, e - m) ;
+    }
+    swap = src ;
+    src = dst ;
+    dst = swap ;
+  }
+
+  if (src != T)
+  {
+    memcpy (T, src, size * sizeof(uint64_t)) ;
+  }
+}
+
+static int larger_segment_first (const void *x, const void *y)
+{
+  const segment_t *a = (const segment_t *) x ;
+  const segment_t *b = (const segment_t *) y ;
+
+  return (a->size < b->size) - (a->size > b->size) ;
+}
+
+void segmented_sort (uint64_t *T, const uint64_t *offsets, const uint64_t nb_segments)
+{
+  segment_t *order ;
+  uint64_t s ;
+
+  order = (segment_t *) malloc (nb_segments * sizeof(segment_t)) ;
+  for (s = 0; s < nb_segments; s++)
+  {
+    order[s].size = offsets[s+1] - offsets[s] ;
+    order[s].index = s ;
+  }
+  qsort (order, nb_segments, sizeof(segment_t), larger_segment_first) ;
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (s = 0; s < nb_segments; s++)
+  {
+    small_array_sort (T + offsets[order[s].index], order[s].size) ;
+  }
+
+  free (order) ;
+}
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   Benchmark of the batched segmented sort against sorting the same
+   segments with one call per array.
+
+   The segment sizes are drawn uniformly between 2^MIN_SEGMENT_LOG and
+   2^MAX_SEGMENT_LOG keys (hundreds to a few thousand), not only powers
+   of two: every kernel takes any size. The last segment is what is left
+   of the array, it may be shorter.
+*/
+
+#define MIN_SEGMENT_LOG 7
+#define MAX_SEGMENT_LOG 12
+
+typedef void (*batch_sort_t) (uint64_t *T, const uint64_t *offsets, const uint64_t nb_segments);
+
+
+static void per_array_sequential_quicksort (uint64_t *T, const uint64_t *offsets, const uint64_t nb_segments)
+{
+  uint64_t s ;
+
+  for (s = 0; s < nb_segments; s++)
+  {
+    sequential_quicksort (T + offsets[s], offsets[s+1] - offsets[s]) ;
+  }
+}
+
+static void per_array_parallel_quicksort (uint64_t *T, const uint64_t *offsets, const uint64_t nb_segments)
+{
+  uint64_t s ;
+
+  for (s = 0; s < nb_segments; s++)
+  {
+    parallel_quicksort (T + offsets[s], offsets[s+1] - offsets[s]) ;
+  }
+}
+
+static void per_array_parallel_merge_sort (uint64_t *T, const uint64_t *offsets, const uint64_t nb_segments)
+{
+  uint64_t s ;
+
+  for (s = 0; s < nb_segments; s++)
+  {
+    #pragma omp parallel
+    {
+      #pragma omp single
+      parallel_merge_sort (T + offsets[s], offsets[s+1] - offsets[s]) ;
+    }
+  }
+}
+
+static uint64_t make_segments (uint64_t *offsets, const uint64_t N)
+{
+  /* random sizes, the last one is clamped to what is left */
+  const uint64_t min = 1UL << MIN_SEGMENT_LOG ;
+  const uint64_t max = 1UL << MAX_SEGMENT_LOG ;
+  uint64_t nb = 0 ;
+  uint64_t done = 0 ;
+  uint64_t size ;
+
+  offsets[0] = 0 ;
+  while (done < N)
+  {
+    size = min + (uint64_t) rand() % (max - min + 1) ;
+    if (size > N - done)
+      size = N - done ;
+    done = done + size ;
+    nb = nb + 1 ;
+    offsets[nb] = done ;
+  }
+  return nb ;
+}
+
+typedef struct
+{
+  batch_sort_t sort ;
+  uint64_t *X ;
+  uint64_t N ;
+  const uint64_t *offsets ;
+  uint64_t nb_segments ;
+  uint64_t fingerprint ;
+  char error [64] ;
+} experiment_arg_t ;
+
+static void prepare (void *arg, const unsigned int exp)
+{
+  experiment_arg_t *e = (experiment_arg_t *) arg ;
+
+  #ifdef RINIT
+    init_array_random (e->X, e->N);
+  #else
+    init_array_sequence (e->X, e->N);
+  #endif
+
+  e->fingerprint = multiset_fingerprint (e->X, e->N) ;
+}
+
+static void run_batch (void *arg)
+{
+  experiment_arg_t *e = (experiment_arg_t *) arg ;
+
+  e->sort (e->X, e->offsets, e->nb_segments) ;
+}
+
+static const char *verify (void *arg, const unsigned int exp)
+{
+  experiment_arg_t *e = (experiment_arg_t *) arg ;
+  uint64_t s ;
+
+  /* every segment is properly sorted */
+  for (s = 0; s < e->nb_segments; s++)
+  {
+    if (! is_sorted (e->X + e->offsets[s], e->offsets[s+1] - e->offsets[s]))
+    {
+      snprintf (e->error, sizeof(e->error), "failed on segment %lu", s) ;
+      return e->error ;
+    }
+  }
+  if (multiset_fingerprint (e->X, e->N) != e->fingerprint)
+    return "lost or duplicated elements" ;
+  return NULL ;
+}
+
+static double run (const char *label, batch_sort_t sort, uint64_t *X, const uint64_t N,
+                   const uint64_t *offsets, const uint64_t nb_segments)
+{
+  experiment_arg_t arg = { sort, X, N, offsets, nb_segments, 0, "" } ;
+  experiment_t e = { &arg, prepare, run_batch, verify } ;
+
+  return run_experiments (label, &e) ;
+}
+
+int main (int argc, char **argv)
+{
+  printf("================================================\n");
+  printf(" Max number of threads: %d \n", omp_get_max_threads());
+  printf(" Merge kernel: %s \n", merge_kernel_name());
+
+  /* the program takes one parameter N, the total number of keys is 2^N */
+  if (argc != 2 || atoi(argv[1]) < MIN_SEGMENT_LOG)
+  {
+      fprintf (stderr, "segsort.run N (N >= %d)\n", MIN_SEGMENT_LOG) ;
+      exit (-1) ;
+  }
+
+  uint64_t N = 1UL << (atoi(argv[1])) ;
+  uint64_t *X = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+  // All the segments but the last have at least 2^MIN_SEGMENT_LOG keys
+  uint64_t *offsets = (uint64_t *) malloc ((N / (1UL << MIN_SEGMENT_LOG) + 2) * sizeof(uint64_t)) ;
+
+  srand (0) ;
+  uint64_t nb_segments = make_segments (offsets, N) ;
+
+  printf(" --> Sorting %lu segments, %lu keys in total (2^%u)\n", nb_segments, N, atoi(argv[1]));
+  #ifdef RINIT
+    printf("--> The array is initialized randomly\n");
+  #endif
+  printf("\n");
+
+  double serial_cycles = run ("per array sequential_quicksort", per_array_sequential_quicksort,
+                              X, N, offsets, nb_segments) ;
+  double quick_cycles = run ("per array parallel_quicksort", per_array_parallel_quicksort,
+                             X, N, offsets, nb_segments) ;
+  double merge_cycles = run ("per array parallel_merge_sort", per_array_parallel_merge_sort,
+                             X, N, offsets, nb_segments) ;
+  double batch_cycles = run ("segmented_sort", segmented_sort,
+                             X, N, offsets, nb_segments) ;
+
+  printf ("\n Speedup vs sequential_quicksort \t%f\n", serial_cycles/batch_cycles) ;
+  printf (" Speedup vs parallel_quicksort \t\t%f\n", quick_cycles/batch_cycles) ;
+  printf (" Speedup vs parallel_merge_sort \t%f\n", merge_cycles/batch_cycles) ;
+
+  free (offsets) ;
+  arena_release (X) ;
+
+  printf("================================================\n\n");
+}
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   selection -- nth element, top-k, partial sort --
+
+   Quickselect: the array is split in three around a pivot (smaller,
+   equal, larger) and only the part holding rank k is processed further,
+   which is O(n) expected work instead of the O(n log n) of a full sort.
+   Large ranges are partitioned by all the threads (count, prefix sum,
+   scatter into a scratch buffer, copy back), the pivot being picked
+   from a sample at about the rank we are looking for.
+*/
+
+/* below this size the selection is sequential */
+#define SELECT_SEQUENTIAL_CUTOFF (1 << 16)
+
+/* number of keys sampled to pick the pivot of a parallel partition */
+#define SELECT_SAMPLE 63
+
+
+static uint64_t next_random (void)
+{
+  /* xorshift, only used to pick sample positions */
+  static __thread uint64_t state = 0x9e3779b97f4a7c15ULL ;
+
+  state ^= state << 13 ;
+  state ^= state >> 7 ;
+  state ^= state << 17 ;
+  return state ;
+}
+
+static uint64_t median_of_three (uint64_t a, uint64_t b, uint64_t c)
+{
+  if (a > b) { uint64_t t = a; a = b; b = t; }
+  if (b > c) { b = c; }
+  return (a > b) ? a : b ;
+}
+
+static uint64_t sequential_select (uint64_t *T, const uint64_t size, const uint64_t k)
+{
+  /* three-way quickselect around a median of three random keys */
+  uint64_t lo = 0 ;
+  uint64_t hi = size ;
+  uint64_t lt, gt, i, pivot, temp ;
+
+  while (hi - lo > 16)
+  {
+    pivot = median_of_three (T[lo + next_random () % (hi - lo)],
+                             T[lo + next_random () % (hi - lo)],
+                             T[lo + next_random () % (hi - lo)]) ;
+    lt = lo ;
+    i = lo ;
+    gt = hi ;
+    while (i < gt)
+    {
+      if (T[i] < pivot)
+      {
+        temp = T[lt] ; T[lt] = T[i] ; T[i] = temp ;
+        lt = lt + 1 ;
+        i = i + 1 ;
+      }
+      else if (T[i] > pivot)
+      {
+        gt = gt - 1 ;
+        temp = T[gt] ; T[gt] = T[i] ; T[i] = temp ;
+      }
+      else
+      {
+        i = i + 1 ;
+      }
+    }
+
+    if (k < lt) hi = lt ;
+    else if (k >= gt) lo = gt ;
+    else return pivot ;
+  }
+
+  insertion_sort (T + lo, hi - lo) ;
+  return T[k] ;
+}
+
+static uint64_t sample_pivot (const uint64_t *T, const uint64_t size, const uint64_t k)
+{
+  uint64_t sample [SELECT_SAMPLE] ;
+  uint64_t i ;
+
+  for (i = 0; i < SELECT_SAMPLE; i++)
+  {
+    sample[i] = T[next_random () % size] ;
+  }
+  insertion_sort (sample, SELECT_SAMPLE) ;
+
+  return sample[k * SELECT_SAMPLE / size] ;
+}
+
+/*
+   Three-way partition of T[0..size) around pivot, using S as scratch.
+   On return T holds the keys < pivot, then == pivot, then > pivot.
+*/
+static void parallel_partition (uint64_t *T, uint64_t *S, const uint64_t size,
+                                const uint64_t pivot, uint64_t *nb_less, uint64_t *nb_equal)
+{
+  int nth = omp_get_max_threads () ;
+  uint64_t *counts = (uint64_t *) calloc (2 * nth, sizeof(uint64_t)) ;
+
+  #pragma omp parallel num_threads(nth)
+  {
+    int tid = omp_get_thread_num () ;
+    int team = omp_get_num_threads () ;
+    uint64_t lo = size * tid / team ;
+    uint64_t hi = size * (tid + 1) / team ;
+    uint64_t lt = 0, eq = 0 ;
+    uint64_t total_lt = 0, total_eq = 0, before_lt = 0, before_eq = 0, before_gt = 0 ;
+    uint64_t i, o_lt, o_eq, o_gt ;
+    int t ;
+
+    #pragma omp simd reduction(+:lt, eq)
+    for (i = lo; i < hi; i++)
+    {
+      lt += T[i] < pivot ;
+      eq += T[i] == pivot ;
+    }
+    counts[2*tid] = lt ;
+    counts[2*tid+1] = eq ;
+
+    #pragma omp barrier
+
+    // Where this thread writes its three groups
+    for (t = 0; t < team; t++)
+    {
+      total_lt += counts[2*t] ;
+      total_eq += counts[2*t+1] ;
+      if (t < tid)
+      {
+        before_lt += counts[2*t] ;
+        before_eq += counts[2*t+1] ;
+        before_gt += size * (t + 1) / team - size * t / team - counts[2*t] - counts[2*t+1] ;
+      }
+    }
+    o_lt = before_lt ;
+    o_eq = total_lt + before_eq ;
+    o_gt = total_lt + total_eq + before_gt ;
+
+    for (i = lo; i < hi; i++)
+    {
+      if (T[i] < pivot) S[o_lt++] = T[i] ;
+      else if (T[i] == pivot) S[o_eq++] = T[i] ;
+      else S[o_gt++] = T[i] ;
+    }
+
+    #pragma omp barrier
+
+    memcpy (T + lo, S + lo, (hi - lo) * sizeof(uint64_t)) ;
+
+    if (tid == 0)
+    {
+      *nb_less = total_lt ;
+      *nb_equal = total_eq ;
+    }
+  }
+
+  free (counts) ;
+}
+
+
+uint64_t parallel_select (uint64_t *T, const uint64_t size, const uint64_t k)
+{
+  /* nth_element: T[k] becomes the key of rank k, the keys before it are
+     not larger and the keys after it are not smaller */
+  uint64_t lo = 0 ;
+  uint64_t hi = size ;
+  uint64_t pivot, nb_less, nb_equal ;
+  uint64_t *S = NULL ;
+
+  // There is no key of rank k: stop rather than read past T
+  if (k >= size)
+  {
+    fprintf (stderr, "ERROR: parallel_select of rank %lu in %lu keys\n", k, size) ;
+    exit (-1) ;
+  }
+
+  while (hi - lo > SELECT_SEQUENTIAL_CUTOFF)
+  {
+    if (S == NULL)
+      S = (uint64_t *) arena_alloc (size * sizeof(uint64_t)) ;
+
+    pivot = sample_pivot (T + lo, hi - lo, k - lo) ;
+    parallel_partition (T + lo, S, hi - lo, pivot, &nb_less, &nb_equal) ;
+
+    if (k - lo < nb_less)
+    {
+      hi = lo + nb_less ;
+    }
+    else if (k - lo < nb_less + nb_equal)
+    {
+      arena_release (S) ;
+      return pivot ;
+    }
+    else
+    {
+      lo = lo + nb_less + nb_equal ;
+    }
+  }
+
+  arena_release (S) ;
+  return sequential_select (T + lo, hi - lo, k - lo) ;
+}
+
+void parallel_top_k (uint64_t *T, const uint64_t size, const uint64_t k)
+{
+  /* the k smallest keys end up in T[0..k), in no particular order */
+  if (k == 0 || k >= size)
+    return ;
+
+  parallel_select (T, size, k - 1) ;
+}
+
+void parallel_partial_sort (uint64_t *T, const uint64_t size, const uint64_t k)
+{
+  /* the k smallest keys end up sorted in T[0..k) */
+  uint64_t n = (k < size) ? k : size ;
+
+  parallel_top_k (T, size, n) ;
+
+  if (n <= SELECT_SEQUENTIAL_CUTOFF)
+    small_array_sort (T, n) ;
+  else
+    parallel_quicksort (T, n) ;
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   sorted array -- incremental merge-in of new batches --
+
+   Each incoming batch is sorted on its own, then merged with the keys
+   already stored by parallel_merge_runs() into a second buffer, and the
+   two buffers are swapped. A batch costs O(b log b + n) instead of the
+   O((n+b) log (n+b)) of sorting the concatenation again. Both buffers
+   grow geometrically, so reallocations are amortized.
+*/
+
+#define SORTED_ARRAY_MIN_CAPACITY 4096
+
+
+void sorted_array_init (sorted_array_t *A)
+{
+  A->keys = NULL ;
+  A->spare = NULL ;
+  A->size = 0 ;
+  A->capacity = 0 ;
+}
+
+void sorted_array_free (sorted_array_t *A)
+{
+  arena_release (A->keys) ;
+  arena_release (A->spare) ;
+  sorted_array_init (A) ;
+}
+
+static void reserve (sorted_array_t *A, const uint64_t needed)
+{
+  uint64_t capacity = (A->capacity > 0) ? A->capacity : SORTED_ARRAY_MIN_CAPACITY ;
+  uint64_t *keys ;
+
+  if (needed <= A->capacity)
+    return ;
+
+  while (capacity < needed)
+    capacity = 2 * capacity ;
+
+  keys = (uint64_t *) arena_alloc (capacity * sizeof(uint64_t)) ;
+  memcpy (keys, A->keys, A->size * sizeof(uint64_t)) ;
+  arena_release (A->keys) ;
+  arena_release (A->spare) ;
+
+  A->keys = keys ;
+  A->spare = (uint64_t *) arena_alloc (capacity * sizeof(uint64_t)) ;
+  A->capacity = capacity ;
+}
+
+void sorted_array_insert (sorted_array_t *A, uint64_t *batch, const uint64_t n)
+{
+  /* batch is sorted in place, then merged in */
+  uint64_t *swap ;
+
+  if (n == 0)
+    return ;
+
+  reserve (A, A->size + n) ;
+
+  parallel_quicksort (batch, n) ;
+  parallel_merge_runs (A->spare, A->keys, A->size, batch, n) ;
+
+  swap = A->keys ;
+  A->keys = A->spare ;
+  A->spare = swap ;
+  A->size = A->size + n ;
+}
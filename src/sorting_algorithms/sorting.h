@@ -1,6 +1,10 @@
 #ifndef __SORTING_H__
 #define __SORTING_H__
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 #define NBEXPERIMENTS    10
 extern long long unsigned int experiments [NBEXPERIMENTS] ;
@@ -13,17 +17,308 @@ void print_array (uint64_t *T, uint64_t size);
 int is_sorted_sequence (uint64_t *T, uint64_t size);
 int is_sorted (uint64_t *T, uint64_t size);
 int are_vector_equals (uint64_t *T1, uint64_t *T2, uint64_t size);
+/* order independent hash of the values of T: equal for any permutation,
+ * different (with high probability) if an element is lost or duplicated */
+uint64_t multiset_fingerprint (uint64_t *T, uint64_t size);
+
+/* peak resident set size of the process so far, in KiB */
+long peak_memory_kb (void);
+
+/* page faults, data TLB misses and allocations over a section of code:
+ * call start, run the code, call stop, c then holds the deltas
+ * (dtlb_misses is UINT64_MAX when perf events are not available) and the
+ * peak resident set size reached in between */
+typedef struct
+{
+    uint64_t page_faults ;
+    uint64_t dtlb_misses ;
+    uint64_t allocations ;       /* malloc family calls + arena mappings */
+    uint64_t allocated_bytes ;
+    uint64_t peak_rss_kb ;
+} mem_counters_t ;
+
+/* every program appends one line per measured variant to this file */
+#define MEM_COUNTERS_CSV "memory.csv"
+
+void mem_counters_start (mem_counters_t *c);
+void mem_counters_stop (mem_counters_t *c);
+void print_mem_counters (const char *label, mem_counters_t *c);
+void write_mem_counters_csv (const char *program, const char *variant, const uint64_t size,
+                             const uint64_t cycles, mem_counters_t *c);
+
+/* calls and bytes requested from the malloc family so far (alloc_hook.c) */
+void alloc_counters (uint64_t *allocations, uint64_t *bytes);
+
+/* buffer arena (arena.c): 64 byte aligned, huge page backed buffers that
+ * are reused once released */
+typedef struct
+{
+    uint64_t mappings ;
+    uint64_t reuses ;
+    uint64_t mapped_bytes ;
+    uint64_t huge_bytes ;
+} arena_stats_t ;
+
+void *arena_alloc (size_t bytes);
+void arena_release (void *p);
+void arena_destroy (void);
+/* per thread scratch buffer of at least count elements, valid until the
+ * next call from the same thread or arena_trim() */
+uint64_t *arena_scratch (uint64_t count);
+/* unmap the released buffers and every scratch buffer, returns the bytes
+ * unmapped; only call it while no sort is running */
+uint64_t arena_trim (void);
+arena_stats_t arena_stats (void);
+
+/* tuning profile (tuning.c), loaded at startup, written by autotune.run */
+typedef struct
+{
+    uint64_t sequential_cutoff ;   /* parallel sorts run sequentially below */
+    uint64_t task_cutoff ;         /* merge sort spawns no task below */
+    uint64_t leaf_size ;           /* recursive sorts use insertion below */
+    uint64_t chunks_per_thread ;   /* chunks sorted by parallel_quicksort */
+} tuning_t ;
+
+extern tuning_t tuning ;
+
+const char *tuning_profile_path (void);
+void tuning_load (void);
+int tuning_save (const char *path);
+void print_tuning (void);
+
+/* sorting kernels (kernels.c) */
+void insertion_sort (uint64_t *T, const uint64_t size);
+int compare_function (const void *x, const void *y);
+void sequential_quicksort (uint64_t *T, const uint64_t size);
+void parallel_quicksort (uint64_t *T, const uint64_t size);
+void sequential_merge_sort (uint64_t *T, const uint64_t size);
+/* the parallel merge sorts spawn tasks: call them from a single region */
+void parallel_merge_sort (uint64_t *T, const uint64_t size);
+void parallel_merge_sort_v2 (uint64_t *T, const uint64_t size, int threads);
+/* same result, each merge runs as soon as its two halves are sorted */
+void parallel_merge_sort_dataflow (uint64_t *T, const uint64_t size);
+
+/* segmented sort (segmented_sort.c) */
+
+/* sequential sort tuned for arrays of up to a few thousand keys */
+void small_array_sort (uint64_t *T, const uint64_t size);
+/* sort every segment T[offsets[s]..offsets[s+1]), s < nb_segments, in
+ * one parallel region */
+void segmented_sort (uint64_t *T, const uint64_t *offsets, const uint64_t nb_segments);
+
+/* duplicate-heavy inputs (duplicates.c) */
+
+/* quicksort with a three-way partition: keys equal to the pivot are
+ * final after each partition */
+void sequential_quicksort_3way (uint64_t *T, uint64_t size);
+void parallel_quicksort_3way (uint64_t *T, const uint64_t size);
+/* counting sort over a per thread hash histogram; returns 0 (T left
+ * unchanged) when there are too many distinct keys */
+int histogram_sort (uint64_t *T, const uint64_t size);
+/* with few distinct keys (sampled), T[0..d) gets the d distinct keys in
+ * order and counts[0..d) (if not NULL) their number of copies, returns d;
+ * returns 0 without touching T otherwise */
+uint64_t histogram_count (uint64_t *T, const uint64_t size, uint64_t *counts);
+/* sort T with one of the above when a sample shows few distinct keys,
+ * returns 0 without touching T otherwise */
+int duplicate_aware_sort (uint64_t *T, const uint64_t size);
+
+/* compressed keys (compressed.c): when max - min of the keys fits in 32
+ * bits the offsets from min are sorted in 32 bit lanes, 16 bit ranges by
+ * counting; the other sorts never do it on their own */
+void parallel_key_range (const uint64_t *T, const uint64_t size, uint64_t *min, uint64_t *max);
+/* bits needed by the offsets: 16, 32 or 64 */
+int key_range_bits (const uint64_t min, const uint64_t max);
+/* sort T through its offsets (quicksort or merge sort structure), return
+ * 16 (counting sort) or 32 (32 bit lanes), 0 without touching T when the
+ * range needs 64 bits; they open their own parallel regions */
+int compressed_quicksort (uint64_t *T, const uint64_t size);
+int compressed_merge_sort (uint64_t *T, const uint64_t size);
+/* 1 by default, 0 (or KEY_COMPRESSION=0) turns them off */
+extern int key_compression ;
+
+/* string keys (string_sort.c): sorted in memcmp order, a key sorts
+ * before the longer keys it is a prefix of */
+typedef struct
+{
+    const char *str ;
+    uint64_t len ;
+} string_key_t ;
+
+/* qsort comparison of two string_key_t */
+int compare_string_keys (const void *x, const void *y);
+void sequential_string_sort (string_key_t *S, const uint64_t n);
+void parallel_string_sort (string_key_t *S, const uint64_t n);
+
+/* sort and deduplicate in one go (unique.c): the duplicates are dropped
+ * while merging the two sorted halves, no pass over the sorted array */
+
+/* sort T and keep one copy of each key in T[0..u), returns u */
+uint64_t parallel_sort_unique (uint64_t *T, const uint64_t size);
+/* sort T, T[0..d) gets the d distinct keys and counts[0..d) their number
+ * of copies, returns d; counts has room for size entries */
+uint64_t parallel_sort_count (uint64_t *T, const uint64_t size, uint64_t *counts);
+
+/* selection (selection.c), expected O(n) work */
+
+/* T[k] becomes the key of rank k, smaller keys before, larger after;
+ * returns T[k]. k < size, the program stops otherwise */
+uint64_t parallel_select (uint64_t *T, const uint64_t size, const uint64_t k);
+/* the k smallest keys are moved to T[0..k), unordered; any k, k >= size
+ * leaves T as it is */
+void parallel_top_k (uint64_t *T, const uint64_t size, const uint64_t k);
+/* the k smallest keys are moved to T[0..k), sorted; k >= size sorts T */
+void parallel_partial_sort (uint64_t *T, const uint64_t size, const uint64_t k);
+
+/* sorted array with incremental merge-in of batches (sorted_array.c) */
+typedef struct
+{
+    uint64_t *keys ;
+    uint64_t *spare ;
+    uint64_t size ;
+    uint64_t capacity ;
+} sorted_array_t ;
+
+void sorted_array_init (sorted_array_t *A);
+void sorted_array_free (sorted_array_t *A);
+/* sort batch (in place) and merge it into A */
+void sorted_array_insert (sorted_array_t *A, uint64_t *batch, const uint64_t n);
+
+/* asynchronous sorts (async_sort.c): the submitted sorts run in order on
+ * a background thread, sort is any of the kernels above (or a wrapper
+ * opening the parallel region of the merge sorts) */
+typedef void (*sort_t) (uint64_t *T, const uint64_t size);
+/* writes the input of experiment exp */
+typedef void (*init_t) (uint64_t *T, const uint64_t size, const unsigned int exp, const void *arg);
+typedef struct sort_handle sort_handle_t ;
+
+/* queue the sort of T and return at once */
+sort_handle_t *sort_submit (sort_t sort, uint64_t *T, const uint64_t size);
+/* non zero once T is sorted */
+int sort_done (sort_handle_t *h);
+/* block until T is sorted, free h, return the cycles the sort took */
+uint64_t sort_wait (sort_handle_t *h);
+
+/* C++ standard library sorts (std_sorts.cpp); without the parallel STL
+ * std_parallel_sort is std::sort */
+void std_sort (uint64_t *T, const uint64_t size);
+void std_stable_sort (uint64_t *T, const uint64_t size);
+void std_parallel_sort (uint64_t *T, const uint64_t size);
+int std_parallel_sort_available (void);
+
+/* reference baselines (baselines.c): time qsort and the std sorts on
+ * arrays filled by init, print them and the speedup of each variant
+ * (labels[v], cycles[v] in Mcycles) against the fastest serial one */
+void report_baselines (init_t init, const void *arg, const uint64_t size,
+                       const char **labels, const double *cycles, const int nb_variants);
+
+/* merge kernels (merge.c) */
+
+/* merge the sorted runs A and B into dst, dst must not overlap them */
+void merge_runs (uint64_t *dst, const uint64_t *A, const uint64_t na,
+                 const uint64_t *B, const uint64_t nb);
+/* same as merge_runs, the output is split among the threads */
+void parallel_merge_runs (uint64_t *dst, const uint64_t *A, const uint64_t na,
+                          const uint64_t *B, const uint64_t nb);
+/* number of keys taken from A among the first k keys of the merge of A
+ * and B, to cut a merge in independent pieces */
+uint64_t merge_co_rank (const uint64_t k, const uint64_t *A, const uint64_t na,
+                        const uint64_t *B, const uint64_t nb);
+/* merge T[0..size) and T[size..2*size) in place, using a scratch buffer */
+void merge (uint64_t *T, const uint64_t size);
+/* merge T[0..n1) and T[n1..n1+n2) in place, using a scratch buffer */
+void merge_pair (uint64_t *T, const uint64_t n1, const uint64_t n2);
+/* name of the kernel selected at runtime: scalar, avx2 or avx512 */
+const char *merge_kernel_name (void);
+
+/* memory bandwidth (bandwidth.c), in GB/s */
+typedef struct
+{
+    double read ;
+    double write ;
+    double copy ;      /* bytes read + bytes written */
+} bandwidth_t ;
+
+/* rdtsc ticks per second */
+double tsc_frequency (void);
+/* stream-style read, write and copy kernels with nb_threads threads */
+void measure_bandwidth (bandwidth_t *b, const int nb_threads);
+/* copy bandwidth with all the threads, measured once */
+double peak_bandwidth (void);
+/* bytes moved to and from memory by a sort of size keys (not counting
+ * the levels that run in cache), passes gets the number of passes over
+ * the array */
+uint64_t merge_sort_traffic (const uint64_t size, const uint64_t nb_threads, uint64_t *passes);
+uint64_t quicksort_traffic (const uint64_t size, const uint64_t nb_chunks, uint64_t *passes);
+/* traffic per pass and achieved GB/s against peak_bandwidth() */
+void print_bandwidth (const char *label, const uint64_t bytes, const uint64_t passes, const uint64_t cycles);
+
+/* tracing (trace.c), only recorded when built with TRACE=1: a span runs
+ * from TRACE_BEGIN (t) to TRACE_END (t, name, size) in the same block,
+ * name must be a string literal; the spans of every thread are written
+ * to $TRACE_FILE (default trace.json) at exit */
+#ifdef TRACE
+#define TRACE_BEGIN(t) const uint64_t t = __builtin_ia32_rdtsc ()
+#define TRACE_END(t, name, size) trace_record (name, t, size)
+#else
+#define TRACE_BEGIN(t)
+#define TRACE_END(t, name, size)
+#endif
+
+/* append the span [start, now) of this thread */
+void trace_record (const char *name, const uint64_t start, const uint64_t size);
+/* write the recorded spans as Chrome trace event JSON */
+int trace_dump (const char *path);
 
 
 /* return the average time in cycles over the values stored in
  * experiments vector */
 uint64_t average_time();
 
+/* timing harness of the benchmarks (utils.c): NBEXPERIMENTS times,
+ * prepare fills the input, run alone is timed, verify returns NULL when
+ * the result is right (else what is wrong, the program stops); prepare
+ * and verify may be NULL */
+typedef struct
+{
+    void *arg ;       /* handed to the three functions */
+    void (*prepare) (void *arg, const unsigned int exp) ;
+    void (*run) (void *arg) ;
+    const char *(*verify) (void *arg, const unsigned int exp) ;
+} experiment_t ;
 
+/* fill experiments and return average_time() */
+uint64_t time_experiments (const char *label, const experiment_t *e);
+/* same, print label and the average Mcycles, and return them */
+double run_experiments (const char *label, const experiment_t *e);
 
+/* init_array_random when built with RAND_INIT=1, init_array_sequence
+ * otherwise */
+void init_array_benchmark (uint64_t *T, const uint64_t size, const unsigned int exp, const void *arg);
 
+/* the common case: sort (T, size) on the keys init writes, checked to be
+ * sorted and to hold the same keys */
+uint64_t time_sort_experiments (const char *label, sort_t sort, uint64_t *T, const uint64_t size,
+                                init_t init, const void *arg);
+double run_sort_experiments (const char *label, sort_t sort, uint64_t *T, const uint64_t size,
+                             init_t init, const void *arg);
 
+/* runtime choice of a kernel (utils.c): kernels[] goes from kernels[0],
+ * which every CPU runs, to the fastest. Returns the fastest supported one,
+ * or the one named by the environment variable env_name when the CPU
+ * supports it; otherwise says so on stderr (when warn) and falls back to
+ * the fastest. */
+typedef struct
+{
+    const char *name ;
+    int supported ;        /* __builtin_cpu_supports of its instructions */
+} kernel_choice_t ;
 
+int select_kernel (const char *env_name, const kernel_choice_t *kernels, const int nb_kernels,
+                   const int warn);
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* __SORTING_H__ */
@@ -0,0 +1,260 @@
+#ifndef __SORTING_HPP__
+#define __SORTING_HPP__
+
+/*
+   C++ front-end of the sorting kernels.
+
+   pap::merge_sort, pap::quicksort and pap::oddeven_sort are templates
+   over the iterator, the key type and the comparator, so the comparison
+   is inlined instead of going through a void* callback, and records can
+   be sorted in place on any member. The first argument selects the
+   sequential or the parallel (OpenMP) version, like the standard
+   execution policies:
+
+       pap::merge_sort (pap::execution::par, v.begin (), v.end (),
+                        [] (const rec &a, const rec &b) { return a.key < b.key; }) ;
+
+   The algorithms and cutoffs are the ones of kernels.c (tuning profile
+   included). uint64_t arrays sorted in ascending order go straight to
+   the C kernels. Iterators must be random access, values default
+   constructible and movable (merges go through a scratch buffer).
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <omp.h>
+
+#include "sorting.h"
+
+namespace pap
+{
+
+namespace execution
+{
+  struct sequenced_policy {} ;
+  struct parallel_policy {} ;
+
+  inline constexpr sequenced_policy seq {} ;
+  inline constexpr parallel_policy par {} ;
+}
+
+namespace detail
+{
+
+template <class Policy>
+inline constexpr bool is_parallel = std::is_same_v<std::decay_t<Policy>, execution::parallel_policy> ;
+
+/* uint64_t keys stored contiguously, ascending order: the C kernels */
+template <class It, class Comp>
+inline constexpr bool use_c_kernels =
+  std::is_pointer_v<It>
+  && std::is_same_v<std::remove_cv_t<std::remove_pointer_t<It>>, uint64_t>
+  && (std::is_same_v<Comp, std::less<>> || std::is_same_v<Comp, std::less<uint64_t>>) ;
+
+template <class It>
+using value_t = typename std::iterator_traits<It>::value_type ;
+
+
+template <class F>
+void in_parallel_region (F &&f)
+{
+  /* tasks need a team: reuse the caller's one if there is one */
+  if (omp_in_parallel ())
+  {
+    f () ;
+    return ;
+  }
+
+  #pragma omp parallel
+  {
+    #pragma omp single
+    f () ;
+  }
+}
+
+template <class It, class Comp>
+void insertion_sort (It first, const std::size_t size, Comp comp)
+{
+  for (std::size_t i = 1; i < size; i++)
+  {
+    value_t<It> temp = std::move (first[i]) ;
+    std::size_t j = i ;
+    for (; j > 0 && comp (temp, first[j-1]); j--)
+    {
+      first[j] = std::move (first[j-1]) ;
+    }
+    first[j] = std::move (temp) ;
+  }
+}
+
+/* merge_runs() of merge.c: the branch only selects what to move */
+template <class In, class Out, class Comp>
+void merge_runs (Out dst, In A, const std::size_t na, In B, const std::size_t nb, Comp comp)
+{
+  std::size_t i = 0, j = 0 ;
+
+  while (i < na && j < nb)
+  {
+    const bool take_b = comp (B[j], A[i]) ;
+    *dst = std::move (take_b ? B[j] : A[i]) ;
+    ++dst ;
+    i += !take_b ;
+    j += take_b ;
+  }
+  dst = std::move (A + i, A + na, dst) ;
+  std::move (B + j, B + nb, dst) ;
+}
+
+/* merge_pair() of merge.c: first[0..n1) and first[n1..n) through buf */
+template <class It, class T, class Comp>
+void merge_pair (It first, const std::size_t n1, const std::size_t n, T *buf, Comp comp)
+{
+  std::move (first, first + n, buf) ;
+  merge_runs (first, buf, n1, buf + n1, n - n1, comp) ;
+}
+
+template <class It, class T, class Comp>
+void merge_sort (It first, const std::size_t size, T *buf, Comp comp, const bool parallel)
+{
+  /* sequential_merge_sort / parallel_merge_sort of kernels.c */
+  const std::size_t half = size / 2 ;
+
+  if (size <= tuning.leaf_size)
+  {
+    insertion_sort (first, size, comp) ;
+    return ;
+  }
+
+  if (parallel && size > tuning.task_cutoff)
+  {
+    #pragma omp task
+    merge_sort (first, half, buf, comp, true) ;
+    #pragma omp task
+    merge_sort (first + half, size - half, buf + half, comp, true) ;
+    #pragma omp taskwait
+  }
+  else
+  {
+    merge_sort (first, half, buf, comp, false) ;
+    merge_sort (first + half, size - half, buf + half, comp, false) ;
+  }
+
+  merge_pair (first, half, size, buf, comp) ;
+}
+
+} // namespace detail
+
+
+template <class Policy, class It, class Comp = std::less<>>
+void merge_sort (Policy &&, It first, It last, Comp comp = Comp ())
+{
+  const std::size_t size = last - first ;
+  constexpr bool parallel = detail::is_parallel<Policy> ;
+
+  if constexpr (detail::use_c_kernels<It, Comp>)
+  {
+    if (parallel && size > tuning.sequential_cutoff)
+      detail::in_parallel_region ([&] { parallel_merge_sort (first, size) ; }) ;
+    else
+      sequential_merge_sort (first, size) ;
+  }
+  else
+  {
+    std::vector<detail::value_t<It>> buf (size) ;
+
+    if (parallel && size > tuning.sequential_cutoff)
+      detail::in_parallel_region ([&] { detail::merge_sort (first, size, buf.data (), comp, true) ; }) ;
+    else
+      detail::merge_sort (first, size, buf.data (), comp, false) ;
+  }
+}
+
+template <class Policy, class It, class Comp = std::less<>>
+void quicksort (Policy &&, It first, It last, Comp comp = Comp ())
+{
+  /* parallel_quicksort of kernels.c: sorted chunks, then merge levels */
+  const std::size_t size = last - first ;
+  constexpr bool parallel = detail::is_parallel<Policy> ;
+
+  if constexpr (detail::use_c_kernels<It, Comp>)
+  {
+    if (parallel)
+      parallel_quicksort (first, size) ;
+    else
+      sequential_quicksort (first, size) ;
+  }
+  else
+  {
+    if (! parallel || size <= tuning.sequential_cutoff)
+    {
+      std::sort (first, last, comp) ;
+      return ;
+    }
+
+    const std::size_t nb_chunks = omp_get_max_threads () * tuning.chunks_per_thread ;
+    std::vector<detail::value_t<It>> buf (size) ;
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (std::size_t c = 0; c < nb_chunks; c++)
+    {
+      std::sort (first + c*size/nb_chunks, first + (c+1)*size/nb_chunks, comp) ;
+    }
+
+    for (std::size_t width = 1; width < nb_chunks; width += width)
+    {
+      #pragma omp parallel for schedule(static)
+      for (std::size_t c = 0; c < nb_chunks; c += 2*width)
+      {
+        if (c + width < nb_chunks)
+        {
+          const std::size_t lo = c*size/nb_chunks ;
+          const std::size_t mid = (c+width)*size/nb_chunks ;
+          const std::size_t hi = std::min (c+2*width, nb_chunks)*size/nb_chunks ;
+          detail::merge_pair (first + lo, mid - lo, hi - lo, buf.data () + lo, comp) ;
+        }
+      }
+    }
+  }
+}
+
+template <class Policy, class It, class Comp = std::less<>>
+void oddeven_sort (Policy &&, It first, It last, Comp comp = Comp ())
+{
+  /* sequential_oddeven_sort / parallel_oddeven_sort of odd-even.c (that
+     one is not a library kernel, so uint64_t goes through the template
+     too) */
+  const std::size_t size = last - first ;
+  const bool parallel = detail::is_parallel<Policy> && size > tuning.sequential_cutoff ;
+  bool sorted ;
+
+  if (size < 2)
+    return ;
+
+  do
+  {
+    sorted = true ;
+    for (std::size_t start = 0; start < 2; start++)
+    {
+      #pragma omp parallel for reduction(&&:sorted) if (parallel)
+      for (std::size_t i = start; i < size - 1; i += 2)
+      {
+        if (comp (first[i+1], first[i]))
+        {
+          std::iter_swap (first + i, first + i + 1) ;
+          sorted = false ;
+        }
+      }
+    }
+  } while (! sorted) ;
+}
+
+} // namespace pap
+
+#endif /* __SORTING_HPP__ */
@@ -0,0 +1,467 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <x86intrin.h>
+
+#include "sorting.h"
+
+/*
+   sortstream -- sorting stdin to stdout within a memory budget --
+
+       producer | ./sortstream.run [binary|text] [MiB] | consumer
+
+   Keys are native endian uint64_t (binary, the default) or decimal
+   numbers separated by white space (text, written back one per line).
+   The budget is one buffer, used in two ways:
+   - while reading, two chunks of half of it: one is filled from stdin
+     while parallel_quicksort_3way sorts the other through sort_submit().
+     That sort works in place, so it needs no scratch memory. Each sorted
+     chunk is appended to a temporary file as a run, while the next chunk
+     is sorted. An input that fits in one chunk is written as soon as it
+     is sorted.
+   - while merging, a read buffer per run and an output buffer. A merge
+     takes at most as many runs as leave each of them MIN_RUN_BUFFER keys.
+     With more runs than that, groups of runs are merged into a new
+     temporary file, pass after pass, until one heap merge to stdout is
+     left. A pass keeps every run in a single file, so two files are open
+     at most, whatever the number of runs.
+   The reader and the writer have IO_BUFFER bytes each on top of the
+   budget. The throughput goes to stderr.
+*/
+
+#define DEFAULT_BUDGET_MIB 256
+
+/* smallest read buffer of a run during a merge, in keys */
+#define MIN_RUN_BUFFER 4096
+
+#define IO_BUFFER (1 << 16)
+
+typedef struct
+{
+  FILE *f ;
+  int text ;
+  char buf [IO_BUFFER] ;
+  uint64_t pos ;
+  uint64_t len ;
+  uint64_t value ;      /* number being parsed (text) */
+  int in_number ;
+  int eof ;
+} reader_t ;
+
+typedef struct
+{
+  FILE *f ;
+  int text ;
+  char buf [IO_BUFFER] ;
+  uint64_t len ;
+} writer_t ;
+
+/* temporary file holding sorted runs one after the other */
+typedef struct
+{
+  FILE *f ;
+  int fd ;
+  uint64_t size ;       /* in keys */
+} run_file_t ;
+
+typedef struct
+{
+  uint64_t offset ;     /* first key in the run file */
+  uint64_t size ;
+} run_t ;
+
+/* run being merged: the part of it in memory */
+typedef struct
+{
+  uint64_t next ;       /* next key to read from the file */
+  uint64_t left ;       /* keys of the run not read yet */
+  uint64_t *keys ;
+  uint64_t pos ;
+  uint64_t len ;
+  uint64_t capacity ;
+} cursor_t ;
+
+
+static void fail (const char *message)
+{
+  fprintf (stderr, "ERROR: %s\n", message) ;
+  exit (-1) ;
+}
+
+static uint64_t read_binary (reader_t *r, uint64_t *T, const uint64_t max)
+{
+  char *bytes = (char *) T ;
+  uint64_t n = 0, got ;
+
+  while (n < max * sizeof(uint64_t) && ! r->eof)
+  {
+    got = fread (bytes + n, 1, max * sizeof(uint64_t) - n, r->f) ;
+    n = n + got ;
+    if (got == 0)
+      r->eof = 1 ;
+  }
+
+  if (n % sizeof(uint64_t) != 0)
+    fail ("the binary input is not a whole number of 64 bit keys") ;
+
+  return n / sizeof(uint64_t) ;
+}
+
+static uint64_t read_text (reader_t *r, uint64_t *T, const uint64_t max)
+{
+  uint64_t n = 0 ;
+  unsigned char c ;
+
+  while (n < max)
+  {
+    if (r->pos == r->len)
+    {
+      if (r->eof)
+        break ;
+      r->len = fread (r->buf, 1, IO_BUFFER, r->f) ;
+      r->pos = 0 ;
+      if (r->len == 0)
+      {
+        r->eof = 1 ;
+        // A number at the very end of the input
+        if (r->in_number)
+        {
+          T[n++] = r->value ;
+          r->in_number = 0 ;
+        }
+        break ;
+      }
+    }
+
+    c = (unsigned char) r->buf[r->pos++] ;
+    if (c >= '0' && c <= '9')
+    {
+      if (r->value > (UINT64_MAX - (c - '0')) / 10)
+        fail ("a key of the text input does not fit in 64 bits") ;
+      r->value = r->value * 10 + (c - '0') ;
+      r->in_number = 1 ;
+    }
+    else if (c == ' ' || c == '\n' || c == '\t' || c == '\r')
+    {
+      if (r->in_number)
+      {
+        T[n++] = r->value ;
+        r->value = 0 ;
+        r->in_number = 0 ;
+      }
+    }
+    else
+    {
+      fail ("the text input has a character that is not a digit or a space") ;
+    }
+  }
+
+  return n ;
+}
+
+static uint64_t read_keys (reader_t *r, uint64_t *T, const uint64_t max)
+{
+  return r->text ? read_text (r, T, max) : read_binary (r, T, max) ;
+}
+
+static void flush_writer (writer_t *w)
+{
+  if (fwrite (w->buf, 1, w->len, w->f) != w->len)
+    fail ("cannot write the output") ;
+  w->len = 0 ;
+}
+
+static void write_keys (writer_t *w, const uint64_t *T, const uint64_t n)
+{
+  char digits [20] ;
+  uint64_t i, v ;
+  int d ;
+
+  if (! w->text)
+  {
+    flush_writer (w) ;
+    if (fwrite (T, sizeof(uint64_t), n, w->f) != n)
+      fail ("cannot write the output") ;
+    return ;
+  }
+
+  for (i = 0; i < n; i++)
+  {
+    if (w->len + sizeof(digits) + 1 > IO_BUFFER)
+      flush_writer (w) ;
+
+    v = T[i] ;
+    d = 0 ;
+    do
+    {
+      digits[d++] = '0' + v % 10 ;
+      v = v / 10 ;
+    } while (v != 0) ;
+
+    while (d > 0)
+      w->buf[w->len++] = digits[--d] ;
+    w->buf[w->len++] = '\n' ;
+  }
+}
+
+/* ------------------------------------------------ run files */
+
+static void open_run_file (run_file_t *rf)
+{
+  rf->f = tmpfile () ;
+  if (rf->f == NULL)
+    fail ("cannot create a temporary file for the sorted runs") ;
+  rf->fd = fileno (rf->f) ;
+  rf->size = 0 ;
+}
+
+static void append_keys (run_file_t *rf, const uint64_t *T, const uint64_t n)
+{
+  const char *bytes = (const char *) T ;
+  uint64_t done = 0, total = n * sizeof(uint64_t) ;
+  ssize_t w ;
+
+  while (done < total)
+  {
+    w = pwrite (rf->fd, bytes + done, total - done, rf->size * sizeof(uint64_t) + done) ;
+    if (w <= 0)
+      fail ("cannot write a sorted run to its temporary file") ;
+    done = done + w ;
+  }
+  rf->size = rf->size + n ;
+}
+
+static void refill (const run_file_t *rf, cursor_t *c)
+{
+  char *bytes = (char *) c->keys ;
+  uint64_t n = (c->left < c->capacity) ? c->left : c->capacity ;
+  uint64_t done = 0, total = n * sizeof(uint64_t) ;
+  ssize_t r ;
+
+  while (done < total)
+  {
+    r = pread (rf->fd, bytes + done, total - done, c->next * sizeof(uint64_t) + done) ;
+    if (r <= 0)
+      fail ("cannot read a sorted run back from its temporary file") ;
+    done = done + r ;
+  }
+
+  c->next = c->next + n ;
+  c->left = c->left - n ;
+  c->pos = 0 ;
+  c->len = n ;
+}
+
+/* ------------------------------------------------ merge */
+
+static void sift_down (const cursor_t *cursors, uint64_t *heap, const uint64_t size, uint64_t i)
+{
+  /* heap of cursor indices ordered by the next key of the run */
+  uint64_t child, temp ;
+
+  for (;;)
+  {
+    child = 2*i + 1 ;
+    if (child >= size)
+      return ;
+    if (child + 1 < size
+        && cursors[heap[child+1]].keys[cursors[heap[child+1]].pos]
+           < cursors[heap[child]].keys[cursors[heap[child]].pos])
+      child = child + 1 ;
+    if (cursors[heap[i]].keys[cursors[heap[i]].pos] <= cursors[heap[child]].keys[cursors[heap[child]].pos])
+      return ;
+    temp = heap[i] ; heap[i] = heap[child] ; heap[child] = temp ;
+    i = child ;
+  }
+}
+
+static void merge_group (const run_file_t *in, const run_t *runs, const uint64_t k,
+                         uint64_t *area, const uint64_t area_keys,
+                         run_file_t *out_file, writer_t *out_writer)
+{
+  /* merge runs[0..k) of in to the end of out_file, or to out_writer;
+     area is split into k + 1 equal buffers, the last one for the output */
+  const uint64_t share = area_keys / (k + 1) ;
+  uint64_t *out = area + k * share ;
+  cursor_t *cursors = (cursor_t *) malloc (k * sizeof(cursor_t)) ;
+  uint64_t *heap = (uint64_t *) malloc (k * sizeof(uint64_t)) ;
+  uint64_t size = 0, n = 0, r ;
+  cursor_t *top ;
+
+  for (r = 0; r < k; r++)
+  {
+    cursors[r].next = runs[r].offset ;
+    cursors[r].left = runs[r].size ;
+    cursors[r].keys = area + r * share ;
+    cursors[r].capacity = share ;
+    refill (in, &cursors[r]) ;
+    if (cursors[r].len > 0)
+      heap[size++] = r ;
+  }
+  for (r = size; r > 0; r--)
+    sift_down (cursors, heap, size, r - 1) ;
+
+  while (size > 0)
+  {
+    top = &cursors[heap[0]] ;
+    out[n++] = top->keys[top->pos++] ;
+    if (n == share)
+    {
+      if (out_writer != NULL)
+        write_keys (out_writer, out, n) ;
+      else
+        append_keys (out_file, out, n) ;
+      n = 0 ;
+    }
+
+    // An exhausted run leaves the heap
+    if (top->pos == top->len)
+    {
+      if (top->left > 0)
+        refill (in, top) ;
+      else
+      {
+        size = size - 1 ;
+        heap[0] = heap[size] ;
+      }
+    }
+    sift_down (cursors, heap, size, 0) ;
+  }
+
+  if (out_writer != NULL)
+    write_keys (out_writer, out, n) ;
+  else
+    append_keys (out_file, out, n) ;
+
+  free (heap) ;
+  free (cursors) ;
+}
+
+static uint64_t merge_runs_to_output (run_file_t *rf, run_t *runs, uint64_t nb_runs,
+                                      uint64_t *area, const uint64_t area_keys, writer_t *w)
+{
+  /* returns the number of passes over the data, the last one included */
+  const uint64_t fan_in = area_keys / MIN_RUN_BUFFER - 1 ;
+  uint64_t passes = 1, g, k, nb_merged ;
+  run_file_t next ;
+
+  while (nb_runs > fan_in)
+  {
+    open_run_file (&next) ;
+    nb_merged = 0 ;
+
+    for (g = 0; g < nb_runs; g += fan_in)
+    {
+      k = (nb_runs - g < fan_in) ? nb_runs - g : fan_in ;
+      runs[nb_merged].offset = next.size ;
+      merge_group (rf, runs + g, k, area, area_keys, &next, NULL) ;
+      runs[nb_merged].size = next.size - runs[nb_merged].offset ;
+      nb_merged = nb_merged + 1 ;
+    }
+
+    // The merged runs are all in next now
+    fclose (rf->f) ;
+    *rf = next ;
+    nb_runs = nb_merged ;
+    passes = passes + 1 ;
+  }
+
+  merge_group (rf, runs, nb_runs, area, area_keys, NULL, w) ;
+  return passes ;
+}
+
+int main (int argc, char **argv)
+{
+  static reader_t reader ;
+  static writer_t writer ;
+  uint64_t *buffers [2] ;
+  uint64_t counts [2] ;
+  run_file_t rf ;
+  run_t *runs = NULL ;
+  uint64_t nb_runs = 0, total = 0, passes = 0 ;
+  sort_handle_t *h ;
+  int cur = 0 ;
+
+  /* the program takes two optional parameters: the format of the keys
+     and the memory budget in MiB */
+  if (argc > 3 || (argc >= 2 && strcmp (argv[1], "binary") != 0 && strcmp (argv[1], "text") != 0)
+      || (argc == 3 && atoi (argv[2]) <= 0))
+  {
+      fprintf (stderr, "sortstream.run [binary|text] [MiB] < keys > sorted_keys \n") ;
+      exit (-1) ;
+  }
+
+  const int text = (argc >= 2 && strcmp (argv[1], "text") == 0) ;
+  const uint64_t budget = (uint64_t) ((argc == 3) ? atoi (argv[2]) : DEFAULT_BUDGET_MIB) << 20 ;
+  const uint64_t area_keys = budget / sizeof(uint64_t) ;
+  const uint64_t chunk = area_keys / 2 ;
+
+  reader.f = stdin ;
+  reader.text = text ;
+  writer.f = stdout ;
+  writer.text = text ;
+
+  uint64_t start = _rdtsc () ;
+
+  uint64_t *area = (uint64_t *) arena_alloc (budget) ;
+  buffers[0] = area ;
+  buffers[1] = area + chunk ;
+
+  counts[cur] = read_keys (&reader, buffers[cur], chunk) ;
+  total = counts[cur] ;
+  h = sort_submit (parallel_quicksort_3way, buffers[cur], counts[cur]) ;
+
+  for (;;)
+  {
+    // Read the next chunk while the current one is sorted
+    counts[1-cur] = read_keys (&reader, buffers[1-cur], chunk) ;
+    total = total + counts[1-cur] ;
+    sort_wait (h) ;
+
+    if (counts[1-cur] == 0 && nb_runs == 0)
+    {
+      // All the input was in one chunk
+      write_keys (&writer, buffers[cur], counts[cur]) ;
+      break ;
+    }
+
+    // Spill the sorted chunk while the next one is sorted
+    if (counts[1-cur] > 0)
+      h = sort_submit (parallel_quicksort_3way, buffers[1-cur], counts[1-cur]) ;
+
+    if (nb_runs == 0)
+      open_run_file (&rf) ;
+    runs = (run_t *) realloc (runs, (nb_runs + 1) * sizeof(run_t)) ;
+    runs[nb_runs].offset = rf.size ;
+    runs[nb_runs].size = counts[cur] ;
+    append_keys (&rf, buffers[cur], counts[cur]) ;
+    nb_runs = nb_runs + 1 ;
+
+    if (counts[1-cur] == 0)
+      break ;
+    cur = 1 - cur ;
+  }
+
+  // No sort is running any more: the whole area holds the merge buffers
+  if (nb_runs > 0)
+  {
+    passes = merge_runs_to_output (&rf, runs, nb_runs, area, area_keys, &writer) ;
+    fclose (rf.f) ;
+  }
+  flush_writer (&writer) ;
+  fflush (stdout) ;
+  free (runs) ;
+  arena_release (area) ;
+
+  double seconds = (_rdtsc () - start) / tsc_frequency () ;
+  fprintf (stderr, " sortstream: %lu keys in %.3lf s, %.2lf Mkeys/s (%lu sorted runs of up to %lu keys,"
+           " %lu merge passes, %d threads)\n",
+           total, seconds, (seconds > 0) ? total / seconds / 1e6 : 0.0, (nb_runs > 0) ? nb_runs : 1, chunk,
+           passes, omp_get_max_threads ()) ;
+
+  return 0 ;
+}
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   Benchmark of the fused sort-unique and sort-count against
+   parallel_quicksort followed by a pass over the sorted array, on arrays
+   with a given number of distinct keys.
+*/
+
+typedef uint64_t (*distinct_t) (uint64_t *T, const uint64_t size, uint64_t *counts) ;
+
+static void init_array_distinct (uint64_t *T, const uint64_t size, const uint64_t distinct)
+{
+  uint64_t i, z ;
+
+  for (i = 0; i < size; i++)
+  {
+    /* splitmix64 of the key index, so the keys are not small integers */
+    z = (uint64_t) (rand () % distinct) + 0x9e3779b97f4a7c15ULL ;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL ;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL ;
+    T[i] = z ^ (z >> 31) ;
+  }
+}
+
+static uint64_t sort_then_unique (uint64_t *T, const uint64_t size, uint64_t *counts)
+{
+  uint64_t i, n = 0 ;
+
+  (void) counts ;
+  parallel_quicksort (T, size) ;
+  for (i = 0; i < size; i++)
+  {
+    if (n == 0 || T[n-1] != T[i])
+      T[n++] = T[i] ;
+  }
+  return n ;
+}
+
+static uint64_t sort_then_count (uint64_t *T, const uint64_t size, uint64_t *counts)
+{
+  uint64_t i, n = 0 ;
+
+  parallel_quicksort (T, size) ;
+  for (i = 0; i < size; i++)
+  {
+    if (n > 0 && T[n-1] == T[i])
+    {
+      counts[n-1] += 1 ;
+    }
+    else
+    {
+      T[n] = T[i] ;
+      counts[n] = 1 ;
+      n = n + 1 ;
+    }
+  }
+  return n ;
+}
+
+static uint64_t fused_unique (uint64_t *T, const uint64_t size, uint64_t *counts)
+{
+  (void) counts ;
+  return parallel_sort_unique (T, size) ;
+}
+
+typedef struct
+{
+  distinct_t op ;
+  uint64_t *X ;
+  uint64_t *counts ;
+  uint64_t N ;
+  uint64_t distinct ;
+  uint64_t *ref_keys ;
+  uint64_t *ref_counts ;
+  uint64_t *ref_n ;
+  uint64_t n ;
+} experiment_arg_t ;
+
+static void prepare (void *arg, const unsigned int exp)
+{
+  experiment_arg_t *e = (experiment_arg_t *) arg ;
+
+  srand (exp) ;
+  init_array_distinct (e->X, e->N, e->distinct) ;
+}
+
+static void run_op (void *arg)
+{
+  experiment_arg_t *e = (experiment_arg_t *) arg ;
+
+  e->n = e->op (e->X, e->N, e->counts) ;
+}
+
+static const char *verify (void *arg, const unsigned int exp)
+{
+  /* the first variant of each kind stores its result in ref_*, the
+     second one is compared with it */
+  experiment_arg_t *e = (experiment_arg_t *) arg ;
+
+  if (exp != 0)
+    return NULL ;
+
+  if (*e->ref_n == 0)
+  {
+    *e->ref_n = e->n ;
+    memcpy (e->ref_keys, e->X, e->n * sizeof(uint64_t)) ;
+    if (e->ref_counts != NULL)
+      memcpy (e->ref_counts, e->counts, e->n * sizeof(uint64_t)) ;
+  }
+
+  if (e->n != *e->ref_n || ! are_vector_equals (e->X, e->ref_keys, e->n)
+      || (e->ref_counts != NULL && ! are_vector_equals (e->counts, e->ref_counts, e->n)))
+    return "does not give the keys of the separate pass" ;
+  return NULL ;
+}
+
+static double run (const char *label, distinct_t op, uint64_t *X, uint64_t *counts, const uint64_t N,
+                   const uint64_t distinct, uint64_t *ref_keys, uint64_t *ref_counts, uint64_t *ref_n)
+{
+  experiment_arg_t arg = { op, X, counts, N, distinct, ref_keys, ref_counts, ref_n, 0 } ;
+  experiment_t e = { &arg, prepare, run_op, verify } ;
+
+  return run_experiments (label, &e) ;
+}
+
+int main (int argc, char **argv)
+{
+  printf("================================================\n");
+  printf(" Max number of threads: %d \n", omp_get_max_threads());
+  print_tuning () ;
+
+  /* the program takes two parameters: N, the array has size 2^N, and the
+     number of distinct keys */
+  if (argc != 3 || strtoul (argv[2], NULL, 10) == 0)
+  {
+      fprintf (stderr, "sortuniq.run N distinct \n") ;
+      exit (-1) ;
+  }
+
+  uint64_t N = 1UL << (atoi(argv[1])) ;
+  uint64_t distinct = strtoul (argv[2], NULL, 10) ;
+  uint64_t *X = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+  uint64_t *counts = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+  uint64_t *ref_keys = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+  uint64_t *ref_counts = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+  uint64_t ref_n = 0 ;
+
+  printf(" --> Sorting an array of size %lu (2^%u) with %lu distinct keys\n\n", N, atoi(argv[1]), distinct);
+
+  double unique_pass = run ("parallel_quicksort + unique pass", sort_then_unique, X, counts, N, distinct,
+                            ref_keys, NULL, &ref_n) ;
+  double unique_fused = run ("parallel_sort_unique", fused_unique, X, counts, N, distinct,
+                             ref_keys, NULL, &ref_n) ;
+  printf (" --> %lu unique keys\n\n", ref_n) ;
+
+  ref_n = 0 ;
+  double count_pass = run ("parallel_quicksort + count pass", sort_then_count, X, counts, N, distinct,
+                           ref_keys, ref_counts, &ref_n) ;
+  double count_fused = run ("parallel_sort_count", parallel_sort_count, X, counts, N, distinct,
+                            ref_keys, ref_counts, &ref_n) ;
+
+  printf ("\n Speedup of parallel_sort_unique \t%f\n", unique_pass/unique_fused) ;
+  printf (" Speedup of parallel_sort_count \t%f\n", count_pass/count_fused) ;
+
+  arena_release (ref_counts) ;
+  arena_release (ref_keys) ;
+  arena_release (counts) ;
+  arena_release (X) ;
+
+  printf("================================================\n\n");
+}
@@ -0,0 +1,43 @@
+#include <cstdint>
+#include <algorithm>
+
+#ifdef HAVE_PSTL
+#include <execution>
+#endif
+
+#include "sorting.h"
+
+/*
+   The C++ standard library sorts behind a C interface, as reference
+   baselines for the kernels (baselines.c). std::sort with
+   std::execution::par needs the TBB backend of libstdc++, the Makefile
+   only defines HAVE_PSTL when its headers are installed.
+*/
+
+extern "C" void std_sort (uint64_t *T, const uint64_t size)
+{
+  std::sort (T, T + size) ;
+}
+
+extern "C" void std_stable_sort (uint64_t *T, const uint64_t size)
+{
+  std::stable_sort (T, T + size) ;
+}
+
+extern "C" int std_parallel_sort_available (void)
+{
+#ifdef HAVE_PSTL
+  return 1 ;
+#else
+  return 0 ;
+#endif
+}
+
+extern "C" void std_parallel_sort (uint64_t *T, const uint64_t size)
+{
+#ifdef HAVE_PSTL
+  std::sort (std::execution::par, T, T + size) ;
+#else
+  std::sort (T, T + size) ;
+#endif
+}
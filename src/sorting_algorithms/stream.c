@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "sorting.h"
+
+/*
+   stream -- memory bandwidth for each number of threads --
+
+   The read, write and copy bandwidth of bandwidth.c, from one thread up
+   to the maximum number of threads, doubling in between. The copy
+   bandwidth with all the threads is the peak the sort reports compare
+   their traffic to.
+*/
+
+int main (int argc, char **argv)
+{
+  bandwidth_t b ;
+  int max_threads = omp_get_max_threads () ;
+  int nb_threads ;
+
+  printf("================================================\n");
+  printf(" Max number of threads: %d \n", max_threads);
+  printf(" TSC frequency: %.3lf GHz \n\n", tsc_frequency () / 1e9);
+
+  printf(" threads \t   read GB/s \t  write GB/s \t   copy GB/s\n");
+  for (nb_threads = 1; ; nb_threads = (2*nb_threads < max_threads) ? 2*nb_threads : max_threads)
+  {
+    measure_bandwidth (&b, nb_threads) ;
+    printf(" %7d \t%12.2lf \t%12.2lf \t%12.2lf\n", nb_threads, b.read, b.write, b.copy);
+    if (nb_threads == max_threads)
+      break ;
+  }
+
+  printf("================================================\n\n");
+}
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   string keys -- multikey quicksort on cached prefix words --
+
+   The keys are (pointer, length) pairs sorted in memcmp order, a key
+   being smaller than the keys it is a prefix of. Comparing two strings
+   means following both pointers, so the sort works on an array of items
+   that cache the 8 bytes of the key at the current depth as a big-endian
+   word: comparing the words compares 8 characters at once, in the item
+   itself. A three-way partition on the word gives the keys smaller and
+   larger than the pivot (same depth) and the keys sharing its 8 bytes;
+   of those, the keys that end within the word are final (ordered by
+   length) and the others go on at depth + 8 after reloading their word,
+   the only time a string is read. Partitions above STRING_TASK_CUTOFF
+   keys are sorted by tasks.
+*/
+
+/* items sorted by insertion below */
+#define STRING_LEAF_SIZE 16
+
+/* partitions sorted by a single task below */
+#define STRING_TASK_CUTOFF 4096
+
+typedef struct
+{
+  uint64_t prefix ;            /* bytes depth..depth+8 of the key, big-endian */
+  uint64_t len ;
+  const unsigned char *str ;
+} string_item_t ;
+
+
+static inline uint64_t load_prefix (const unsigned char *s, const uint64_t len, const uint64_t depth)
+{
+  /* past the end of the key the bytes read as 0 */
+  uint64_t w = 0 ;
+  uint64_t i ;
+
+  if (len >= depth + 8)
+  {
+    memcpy (&w, s + depth, 8) ;
+    return __builtin_bswap64 (w) ;
+  }
+
+  for (i = depth; i < depth + 8; i++)
+  {
+    w = (w << 8) | ((i < len) ? s[i] : 0) ;
+  }
+  return w ;
+}
+
+static int compare_from (const string_item_t *a, const string_item_t *b, const uint64_t depth)
+{
+  /* both keys are equal before depth */
+  uint64_t n = (a->len < b->len) ? a->len : b->len ;
+  int c ;
+
+  if (a->prefix != b->prefix)
+    return (a->prefix > b->prefix) - (a->prefix < b->prefix) ;
+
+  if (n > depth)
+  {
+    c = memcmp (a->str + depth, b->str + depth, n - depth) ;
+    if (c != 0)
+      return c ;
+  }
+  return (a->len > b->len) - (a->len < b->len) ;
+}
+
+static void insertion_sort_items (string_item_t *A, const uint64_t n, const uint64_t depth)
+{
+  string_item_t temp ;
+  uint64_t i, j ;
+
+  for (i = 1; i < n; i++)
+  {
+    temp = A[i] ;
+    for (j = i; j > 0 && compare_from (&A[j-1], &temp, depth) > 0; j--)
+    {
+      A[j] = A[j-1] ;
+    }
+    A[j] = temp ;
+  }
+}
+
+static uint64_t median_of_three (uint64_t a, uint64_t b, uint64_t c)
+{
+  if (a > b) { uint64_t t = a; a = b; b = t; }
+  if (b > c) { b = c; }
+  return (a > b) ? a : b ;
+}
+
+static void partition_items (string_item_t *A, const uint64_t n, uint64_t *lt, uint64_t *gt)
+{
+  /* A[0..lt) < pivot, A[lt..gt) == pivot, A[gt..n) > pivot */
+  const uint64_t pivot = median_of_three (A[0].prefix, A[n / 2].prefix, A[n - 1].prefix) ;
+  uint64_t l = 0, i = 0, g = n ;
+  string_item_t temp ;
+
+  while (i < g)
+  {
+    if (A[i].prefix < pivot)
+    {
+      temp = A[l] ; A[l] = A[i] ; A[i] = temp ;
+      l = l + 1 ;
+      i = i + 1 ;
+    }
+    else if (A[i].prefix > pivot)
+    {
+      g = g - 1 ;
+      temp = A[g] ; A[g] = A[i] ; A[i] = temp ;
+    }
+    else
+    {
+      i = i + 1 ;
+    }
+  }
+
+  *lt = l ;
+  *gt = g ;
+}
+
+static uint64_t split_finished (string_item_t *A, const uint64_t n, const uint64_t depth)
+{
+  /* A shares its word at depth: the keys ending in it go first, the
+     others get their next word. Returns how many ended */
+  uint64_t done = 0, i, l ;
+  string_item_t temp ;
+
+  // Equal up to their end, so only the length orders them: one pass per
+  // length, at most 9
+  for (l = depth; l <= depth + 8; l++)
+  {
+    for (i = done; i < n; i++)
+    {
+      if (A[i].len == l)
+      {
+        temp = A[done] ; A[done] = A[i] ; A[i] = temp ;
+        done = done + 1 ;
+      }
+    }
+  }
+
+  for (i = done; i < n; i++)
+  {
+    A[i].prefix = load_prefix (A[i].str, A[i].len, depth + 8) ;
+  }
+  return done ;
+}
+
+static void multikey_quicksort (string_item_t *A, uint64_t n, uint64_t depth, const int tasks)
+{
+  uint64_t lt, gt, done ;
+
+  // Recursion on the smaller and larger keys, loop on the pivot's word
+  while (n > STRING_LEAF_SIZE)
+  {
+    partition_items (A, n, &lt, &gt) ;
+
+    if (tasks && lt > STRING_TASK_CUTOFF)
+    {
+      #pragma omp task
+      multikey_quicksort (A, lt, depth, tasks) ;
+    }
+    else
+    {
+      multikey_quicksort (A, lt, depth, tasks) ;
+    }
+
+    if (tasks && n - gt > STRING_TASK_CUTOFF)
+    {
+      #pragma omp task
+      multikey_quicksort (A + gt, n - gt, depth, tasks) ;
+    }
+    else
+    {
+      multikey_quicksort (A + gt, n - gt, depth, tasks) ;
+    }
+
+    // The pivot's word is shared by A[lt..gt): one word deeper
+    done = split_finished (A + lt, gt - lt, depth) ;
+    A = A + lt + done ;
+    n = gt - lt - done ;
+    depth = depth + 8 ;
+  }
+
+  insertion_sort_items (A, n, depth) ;
+}
+
+static string_item_t *load_items (const string_key_t *S, const uint64_t n, const int parallel)
+{
+  string_item_t *A = (string_item_t *) malloc (n * sizeof(string_item_t)) ;
+  uint64_t i ;
+
+  #pragma omp parallel for schedule(static) if (parallel)
+  for (i = 0; i < n; i++)
+  {
+    A[i].str = (const unsigned char *) S[i].str ;
+    A[i].len = S[i].len ;
+    A[i].prefix = load_prefix (A[i].str, A[i].len, 0) ;
+  }
+  return A ;
+}
+
+static void store_items (string_key_t *S, string_item_t *A, const uint64_t n, const int parallel)
+{
+  uint64_t i ;
+
+  #pragma omp parallel for schedule(static) if (parallel)
+  for (i = 0; i < n; i++)
+  {
+    S[i].str = (const char *) A[i].str ;
+    S[i].len = A[i].len ;
+  }
+  free (A) ;
+}
+
+int compare_string_keys (const void *x, const void *y)
+{
+  const string_key_t *a = (const string_key_t *) x ;
+  const string_key_t *b = (const string_key_t *) y ;
+  uint64_t n = (a->len < b->len) ? a->len : b->len ;
+  int c = memcmp (a->str, b->str, n) ;
+
+  if (c != 0)
+    return c ;
+  return (a->len > b->len) - (a->len < b->len) ;
+}
+
+void sequential_string_sort (string_key_t *S, const uint64_t n)
+{
+  string_item_t *A = load_items (S, n, 0) ;
+
+  multikey_quicksort (A, n, 0, 0) ;
+  store_items (S, A, n, 0) ;
+}
+
+void parallel_string_sort (string_key_t *S, const uint64_t n)
+{
+  string_item_t *A ;
+
+  if (n <= tuning.sequential_cutoff)
+  {
+    sequential_string_sort (S, n) ;
+    return ;
+  }
+
+  A = load_items (S, n, 1) ;
+
+  #pragma omp parallel
+  {
+    #pragma omp single
+    multikey_quicksort (A, n, 0, 1) ;
+  }
+
+  store_items (S, A, n, 1) ;
+}
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   Benchmark of the string sorts on generated keys:
+   - random: 4 to 32 random lowercase letters
+   - ids: "user-" and a zero padded random number, long shared prefix
+   - paths: a few directory levels and a file name, as a file list
+*/
+
+/* bytes reserved per generated key */
+#define MAX_KEY_BYTES 64
+
+typedef void (*string_sort_t) (string_key_t *S, const uint64_t n) ;
+
+static uint64_t state = 0x9e3779b97f4a7c15ULL ;
+
+static uint64_t next_random (void)
+{
+  state ^= state << 13 ;
+  state ^= state >> 7 ;
+  state ^= state << 17 ;
+  return state ;
+}
+
+static uint64_t generate (const char *dataset, char *pool, string_key_t *S, const uint64_t n)
+{
+  /* returns 0 for an unknown dataset */
+  uint64_t i, j, len ;
+  char *s ;
+
+  for (i = 0; i < n; i++)
+  {
+    s = pool + i * MAX_KEY_BYTES ;
+
+    if (strcmp (dataset, "random") == 0)
+    {
+      len = 4 + next_random () % 29 ;
+      for (j = 0; j < len; j++)
+        s[j] = 'a' + next_random () % 26 ;
+    }
+    else if (strcmp (dataset, "ids") == 0)
+    {
+      len = snprintf (s, MAX_KEY_BYTES, "user-%012lu", next_random () % (4 * n)) ;
+    }
+    else if (strcmp (dataset, "paths") == 0)
+    {
+      len = snprintf (s, MAX_KEY_BYTES, "/srv/data/%s/part-%03lu/chunk%lu.bin",
+                      (next_random () & 1) ? "archive" : "current",
+                      next_random () % 64, next_random () % n) ;
+    }
+    else
+    {
+      return 0 ;
+    }
+
+    S[i].str = s ;
+    S[i].len = len ;
+  }
+  return 1 ;
+}
+
+static uint64_t string_fingerprint (const string_key_t *S, const uint64_t n)
+{
+  /* order independent: sum of the FNV-1a hashes of the keys */
+  uint64_t sum = 0, h, i, j ;
+
+  for (i = 0; i < n; i++)
+  {
+    h = 0xcbf29ce484222325ULL ;
+    for (j = 0; j < S[i].len; j++)
+    {
+      h = (h ^ (unsigned char) S[i].str[j]) * 0x100000001b3ULL ;
+    }
+    sum += h ;
+  }
+  return sum ;
+}
+
+static int strings_sorted (const string_key_t *S, const uint64_t n)
+{
+  uint64_t i ;
+
+  for (i = 1; i < n; i++)
+  {
+    if (compare_string_keys (&S[i-1], &S[i]) > 0)
+      return 0 ;
+  }
+  return 1 ;
+}
+
+static void qsort_strings (string_key_t *S, const uint64_t n)
+{
+  qsort (S, n, sizeof(string_key_t), compare_string_keys) ;
+}
+
+typedef struct
+{
+  string_sort_t sort ;
+  string_key_t *S ;
+  const string_key_t *input ;
+  uint64_t n ;
+  uint64_t fingerprint ;
+} experiment_arg_t ;
+
+static void prepare (void *arg, const unsigned int exp)
+{
+  experiment_arg_t *e = (experiment_arg_t *) arg ;
+
+  memcpy (e->S, e->input, e->n * sizeof(string_key_t)) ;
+}
+
+static void run_sort (void *arg)
+{
+  experiment_arg_t *e = (experiment_arg_t *) arg ;
+
+  e->sort (e->S, e->n) ;
+}
+
+static const char *verify (void *arg, const unsigned int exp)
+{
+  experiment_arg_t *e = (experiment_arg_t *) arg ;
+
+  if (! strings_sorted (e->S, e->n))
+    return "failed" ;
+  if (string_fingerprint (e->S, e->n) != e->fingerprint)
+    return "lost or duplicated keys" ;
+  return NULL ;
+}
+
+static double run (const char *label, string_sort_t sort, string_key_t *S, const string_key_t *input,
+                   const uint64_t n, const uint64_t fingerprint)
+{
+  experiment_arg_t arg = { sort, S, input, n, fingerprint } ;
+  experiment_t e = { &arg, prepare, run_sort, verify } ;
+
+  return run_experiments (label, &e) ;
+}
+
+int main (int argc, char **argv)
+{
+  printf("================================================\n");
+  printf(" Max number of threads: %d \n", omp_get_max_threads());
+  print_tuning () ;
+
+  /* the program takes one parameter N, there are 2^N keys, and
+     optionally the dataset */
+  if (argc < 2 || argc > 3)
+  {
+      fprintf (stderr, "strsort.run N [random|ids|paths] \n") ;
+      exit (-1) ;
+  }
+
+  uint64_t N = 1UL << (atoi(argv[1])) ;
+  const char *dataset = (argc == 3) ? argv[2] : "random" ;
+  char *pool = (char *) arena_alloc (N * MAX_KEY_BYTES) ;
+  string_key_t *input = (string_key_t *) arena_alloc (N * sizeof(string_key_t)) ;
+  string_key_t *S = (string_key_t *) arena_alloc (N * sizeof(string_key_t)) ;
+
+  if (! generate (dataset, pool, input, N))
+  {
+      fprintf (stderr, "ERROR: unknown dataset %s\n", dataset) ;
+      exit (-1) ;
+  }
+  uint64_t fingerprint = string_fingerprint (input, N) ;
+
+  printf(" --> Sorting %lu (2^%u) %s string keys\n\n", N, atoi(argv[1]), dataset);
+
+  double qsort_cycles = run ("qsort (memcmp)", qsort_strings, S, input, N, fingerprint) ;
+  double sequential_cycles = run ("sequential_string_sort", sequential_string_sort, S, input, N, fingerprint) ;
+  double parallel_cycles = run ("parallel_string_sort", parallel_string_sort, S, input, N, fingerprint) ;
+
+  printf ("\n Speedup of sequential_string_sort vs qsort \t%f\n", qsort_cycles/sequential_cycles) ;
+  printf (" Speedup of parallel_string_sort vs qsort \t%f\n", qsort_cycles/parallel_cycles) ;
+  printf (" Speedup: \t\t\t\t\t%f\n", sequential_cycles/parallel_cycles) ;
+
+  arena_release (S) ;
+  arena_release (input) ;
+  arena_release (pool) ;
+
+  printf("================================================\n\n");
+}
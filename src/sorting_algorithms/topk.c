@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   Benchmark of the order statistic queries (median, top-k, partial sort)
+   against answering them with a full sort.
+*/
+
+typedef void (*query_t) (uint64_t *T, const uint64_t size, const uint64_t k);
+
+
+static void full_sequential_quicksort (uint64_t *T, const uint64_t size, const uint64_t k)
+{
+  sequential_quicksort (T, size) ;
+}
+
+static void full_parallel_quicksort (uint64_t *T, const uint64_t size, const uint64_t k)
+{
+  parallel_quicksort (T, size) ;
+}
+
+static void median (uint64_t *T, const uint64_t size, const uint64_t k)
+{
+  parallel_select (T, size, size / 2) ;
+}
+
+static uint64_t max_of (const uint64_t *T, const uint64_t size)
+{
+  uint64_t i, m = 0 ;
+
+  for (i = 0; i < size; i++)
+    m = (T[i] > m) ? T[i] : m ;
+  return m ;
+}
+
+static uint64_t min_of (const uint64_t *T, const uint64_t size)
+{
+  uint64_t i, m = UINT64_MAX ;
+
+  for (i = 0; i < size; i++)
+    m = (T[i] < m) ? T[i] : m ;
+  return m ;
+}
+
+/* X is the output of the query, Y the fully sorted input */
+static int check (query_t query, uint64_t *X, uint64_t *Y, const uint64_t N, const uint64_t k)
+{
+  uint64_t m = N / 2 ;
+
+  if (query == full_sequential_quicksort || query == full_parallel_quicksort)
+    return are_vector_equals (X, Y, N) ;
+
+  if (query == median)
+    return X[m] == Y[m] && max_of (X, m) <= X[m] && min_of (X + m + 1, N - m - 1) >= X[m] ;
+
+  if (query == parallel_top_k)
+    return max_of (X, k) == Y[k-1] && multiset_fingerprint (X, k) == multiset_fingerprint (Y, k) ;
+
+  return are_vector_equals (X, Y, k) ;
+}
+
+typedef struct
+{
+  query_t query ;
+  uint64_t *X ;
+  uint64_t *Y ;
+  uint64_t N ;
+  uint64_t k ;
+  uint64_t fingerprint ;
+} experiment_arg_t ;
+
+static void prepare (void *arg, const unsigned int exp)
+{
+  experiment_arg_t *e = (experiment_arg_t *) arg ;
+
+  #ifdef RINIT
+    init_array_random (e->X, e->N);
+  #else
+    init_array_sequence (e->X, e->N);
+  #endif
+  memcpy (e->Y, e->X, e->N * sizeof(uint64_t)) ;
+  parallel_quicksort (e->Y, e->N) ;
+
+  e->fingerprint = multiset_fingerprint (e->X, e->N) ;
+}
+
+static void run_query (void *arg)
+{
+  experiment_arg_t *e = (experiment_arg_t *) arg ;
+
+  e->query (e->X, e->N, e->k) ;
+}
+
+static const char *verify (void *arg, const unsigned int exp)
+{
+  experiment_arg_t *e = (experiment_arg_t *) arg ;
+
+  if (! check (e->query, e->X, e->Y, e->N, e->k))
+    return "gave a wrong answer" ;
+  if (multiset_fingerprint (e->X, e->N) != e->fingerprint)
+    return "lost or duplicated elements" ;
+  return NULL ;
+}
+
+static double run (const char *label, query_t query, uint64_t *X, uint64_t *Y,
+                   const uint64_t N, const uint64_t k)
+{
+  experiment_arg_t arg = { query, X, Y, N, k, 0 } ;
+  experiment_t e = { &arg, prepare, run_query, verify } ;
+
+  return run_experiments (label, &e) ;
+}
+
+int main (int argc, char **argv)
+{
+  printf("================================================\n");
+  printf(" Max number of threads: %d \n", omp_get_max_threads());
+
+  /* the program takes the size 2^N of the array and optionally k, the
+     number of smallest keys wanted (default 1% of the array) */
+  if (argc != 2 && argc != 3)
+  {
+      fprintf (stderr, "topk.run N [k] \n") ;
+      exit (-1) ;
+  }
+
+  uint64_t N = 1UL << (atoi(argv[1])) ;
+  uint64_t k = (argc == 3) ? strtoull (argv[2], NULL, 10) : N / 100 ;
+  if (k == 0) k = 1 ;
+  if (k > N) k = N ;
+
+  uint64_t *X = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+  uint64_t *Y = (uint64_t *) arena_alloc (N * sizeof(uint64_t)) ;
+
+  printf(" --> Array of size %lu (2^%u), k = %lu\n", N, atoi(argv[1]), k);
+  #ifdef RINIT
+    printf("--> The array is initialized randomly\n");
+  #endif
+  printf("\n");
+
+  double serial_cycles = run ("full sequential_quicksort", full_sequential_quicksort, X, Y, N, k) ;
+  double sort_cycles = run ("full parallel_quicksort", full_parallel_quicksort, X, Y, N, k) ;
+  double median_cycles = run ("parallel_select (median)", median, X, Y, N, k) ;
+  double topk_cycles = run ("parallel_top_k", parallel_top_k, X, Y, N, k) ;
+  double partial_cycles = run ("parallel_partial_sort", parallel_partial_sort, X, Y, N, k) ;
+
+  printf ("\n Speedup vs full sort (serial / parallel)\n") ;
+  printf (" median \t\t%f / %f\n", serial_cycles/median_cycles, sort_cycles/median_cycles) ;
+  printf (" top-k \t\t\t%f / %f\n", serial_cycles/topk_cycles, sort_cycles/topk_cycles) ;
+  printf (" partial sort \t\t%f / %f\n", serial_cycles/partial_cycles, sort_cycles/partial_cycles) ;
+
+  arena_release (X) ;
+  arena_release (Y) ;
+
+  printf("================================================\n\n");
+}
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <x86intrin.h>
+
+#include "sorting.h"
+
+/*
+   tracing -- per thread timelines in the Chrome trace event format --
+
+   Built with TRACE=1 (-DTRACE), the kernels wrap their tasks, chunk sorts,
+   merges and taskwaits in TRACE_BEGIN / TRACE_END. Every thread
+   appends the finished spans to its own ring buffer, so recording costs
+   two rdtsc and a few stores, without locks; a ring keeps the last
+   TRACE_RING spans of its thread. At exit the rings are written as
+   complete ("X") events to TRACE_FILE (default trace.json), which
+   chrome://tracing or ui.perfetto.dev open as one lane per thread.
+*/
+
+#define TRACE_RING (1 << 16)
+#define TRACE_MAX_THREADS 256
+#define DEFAULT_TRACE_FILE "trace.json"
+
+typedef struct
+{
+  const char *name ;
+  uint64_t start ;
+  uint64_t end ;
+  uint64_t size ;
+} trace_event_t ;
+
+typedef struct
+{
+  trace_event_t events [TRACE_RING] ;
+  uint64_t count ;
+} trace_ring_t ;
+
+static trace_ring_t *rings [TRACE_MAX_THREADS] ;
+static int nb_rings ;
+static uint64_t origin = UINT64_MAX ;
+static __thread trace_ring_t *ring ;
+static __thread int ring_full ;
+
+
+static void trace_at_exit (void)
+{
+  const char *env = getenv ("TRACE_FILE") ;
+
+  trace_dump ((env != NULL) ? env : DEFAULT_TRACE_FILE) ;
+}
+
+static trace_ring_t *register_thread (void)
+{
+  trace_ring_t *r = (trace_ring_t *) calloc (1, sizeof(trace_ring_t)) ;
+
+  #pragma omp critical (trace)
+  {
+    if (nb_rings == 0)
+      atexit (trace_at_exit) ;
+
+    if (nb_rings < TRACE_MAX_THREADS)
+    {
+      rings[nb_rings] = r ;
+      nb_rings = nb_rings + 1 ;
+    }
+    else
+    {
+      free (r) ;
+      r = NULL ;
+    }
+  }
+  return r ;
+}
+
+void trace_record (const char *name, const uint64_t start, const uint64_t size)
+{
+  const uint64_t end = _rdtsc () ;
+  trace_event_t *e ;
+
+  if (ring == NULL)
+  {
+    // Threads past TRACE_MAX_THREADS are not traced
+    if (ring_full)
+      return ;
+    ring = register_thread () ;
+    if (ring == NULL)
+    {
+      ring_full = 1 ;
+      return ;
+    }
+  }
+
+  e = &ring->events[ring->count % TRACE_RING] ;
+  e->name = name ;
+  e->start = start ;
+  e->end = end ;
+  e->size = size ;
+  ring->count = ring->count + 1 ;
+}
+
+int trace_dump (const char *path)
+{
+  FILE *f ;
+  double us_per_tick ;
+  uint64_t i, first, dropped = 0 ;
+  trace_event_t *e ;
+  int t, comma = 0 ;
+
+  if (nb_rings == 0)
+    return 0 ;
+
+  f = fopen (path, "w") ;
+  if (f == NULL)
+  {
+    fprintf (stderr, "ERROR: cannot write the trace to %s\n", path) ;
+    return -1 ;
+  }
+
+  // Timestamps in microseconds from the first recorded span
+  for (t = 0; t < nb_rings; t++)
+  {
+    first = (rings[t]->count > TRACE_RING) ? rings[t]->count - TRACE_RING : 0 ;
+    for (i = first; i < rings[t]->count; i++)
+    {
+      if (rings[t]->events[i % TRACE_RING].start < origin)
+        origin = rings[t]->events[i % TRACE_RING].start ;
+    }
+  }
+  us_per_tick = 1e6 / tsc_frequency () ;
+
+  fprintf (f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n") ;
+  for (t = 0; t < nb_rings; t++)
+  {
+    fprintf (f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+             comma ? ",\n" : "", t, t) ;
+    comma = 1 ;
+
+    first = (rings[t]->count > TRACE_RING) ? rings[t]->count - TRACE_RING : 0 ;
+    dropped += first ;
+    for (i = first; i < rings[t]->count; i++)
+    {
+      e = &rings[t]->events[i % TRACE_RING] ;
+      fprintf (f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3lf,\"dur\":%.3lf,"
+                  "\"args\":{\"size\":%lu}}",
+               e->name, t, (e->start - origin) * us_per_tick, (e->end - e->start) * us_per_tick, e->size) ;
+    }
+  }
+  fprintf (f, "\n]}\n") ;
+  fclose (f) ;
+
+  fprintf (stderr, " Trace of %d threads written to %s", nb_rings, path) ;
+  if (dropped > 0)
+    fprintf (stderr, " (%lu oldest spans overwritten)", dropped) ;
+  fprintf (stderr, "\n") ;
+
+  return 0 ;
+}
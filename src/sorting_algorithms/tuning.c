@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   Tuning profile: the cutoffs used by the sorting algorithms.
+
+   The values are read at startup from the profile file written by
+   autotune.run (SORT_PROFILE, or sort_profile.txt in the current
+   directory). Without a profile the defaults below are used. The file
+   is a list of "name = value" lines, unknown names are ignored.
+*/
+
+#define DEFAULT_PROFILE "sort_profile.txt"
+
+tuning_t tuning =
+{
+  .sequential_cutoff = 1 << 14,
+  .task_cutoff = 1 << 14,
+  .leaf_size = 16,
+  .chunks_per_thread = 1,
+};
+
+static char profile_path [1024] ;
+static int profile_loaded ;
+
+
+const char *tuning_profile_path (void)
+{
+  const char *env = getenv ("SORT_PROFILE") ;
+
+  return (env != NULL) ? env : DEFAULT_PROFILE ;
+}
+
+static void set (const char *name, uint64_t value)
+{
+  if (value == 0)
+    return ;
+
+  if (strcmp (name, "sequential_cutoff") == 0)
+    tuning.sequential_cutoff = value ;
+  else if (strcmp (name, "task_cutoff") == 0)
+    tuning.task_cutoff = value ;
+  else if (strcmp (name, "leaf_size") == 0)
+    tuning.leaf_size = (value < 2) ? 2 : value ;
+  else if (strcmp (name, "chunks_per_thread") == 0)
+    tuning.chunks_per_thread = value ;
+}
+
+__attribute__((constructor))
+void tuning_load (void)
+{
+  char line [256], name [128] ;
+  unsigned long long value ;
+  FILE *f ;
+
+  snprintf (profile_path, sizeof(profile_path), "%s", tuning_profile_path ()) ;
+  f = fopen (profile_path, "r") ;
+  if (f == NULL)
+    return ;
+
+  while (fgets (line, sizeof(line), f) != NULL)
+  {
+    if (line[0] == '#')
+      continue ;
+    if (sscanf (line, " %127[a-z_] = %llu", name, &value) == 2)
+      set (name, value) ;
+  }
+  fclose (f) ;
+  profile_loaded = 1 ;
+}
+
+int tuning_save (const char *path)
+{
+  FILE *f = fopen (path, "w") ;
+
+  if (f == NULL)
+    return -1 ;
+
+  fprintf (f, "# written by autotune.run, read at startup by every program\n") ;
+  fprintf (f, "sequential_cutoff = %lu\n", tuning.sequential_cutoff) ;
+  fprintf (f, "task_cutoff = %lu\n", tuning.task_cutoff) ;
+  fprintf (f, "leaf_size = %lu\n", tuning.leaf_size) ;
+  fprintf (f, "chunks_per_thread = %lu\n", tuning.chunks_per_thread) ;
+  fclose (f) ;
+
+  return 0 ;
+}
+
+void print_tuning (void)
+{
+  printf (" Tuning: %s (sequential below %lu, tasks above %lu, leaf %lu, %lu chunk(s)/thread)\n",
+          profile_loaded ? profile_path : "defaults",
+          tuning.sequential_cutoff, tuning.task_cutoff, tuning.leaf_size, tuning.chunks_per_thread) ;
+}
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sorting.h"
+
+/*
+   sort-unique and sort-count -- duplicates dropped in the last merge --
+
+   Sorting then deduplicating reads and writes the sorted array once more.
+   Here the two halves of T are sorted by parallel_quicksort and their
+   merge, the last pass of the sort, only writes a key when it differs
+   from the previous one (or increments its count). The merge is cut in
+   one piece per thread with merge_co_rank(), every thread writes its
+   keys at the start of its piece of a scratch buffer, a run of equal
+   keys cut between two pieces is joined, and the pieces are compacted
+   into T. The output is only as large as the number of distinct keys.
+   With few distinct keys (sampled) the sorted histogram of duplicates.c
+   gives the result without sorting T at all.
+*/
+
+static inline __attribute__((always_inline))
+uint64_t merge_distinct (uint64_t *keys, uint64_t *counts, const uint64_t *A, const uint64_t na,
+                         const uint64_t *B, const uint64_t nb, const int with_counts)
+{
+  /* merge A and B into keys, one copy per key (and its count); returns
+     the number of keys written. Without branches on the keys: every key
+     is written at keys[n], n only moves on when it differs from keys[n-1]
+     (keys[0] is the smallest key with a count of 0, so the first key
+     taken lands on it) */
+  uint64_t i = 0, j = 0, n = 1 ;
+  uint64_t x, is_new, take_a ;
+
+  if (na + nb == 0)
+    return 0 ;
+
+  keys[0] = (nb == 0 || (na > 0 && A[0] <= B[0])) ? A[0] : B[0] ;
+  if (with_counts)
+    counts[0] = 0 ;
+
+  // Emit m writes at most keys[m-1] except the first one, which writes
+  // keys[1]: a single key would go one past the piece
+  if (na + nb == 1)
+  {
+    if (with_counts)
+      counts[0] = 1 ;
+    return 1 ;
+  }
+
+  #define EMIT(key)                                   \
+    do {                                              \
+      x = (key) ;                                     \
+      is_new = x != keys[n-1] ;                       \
+      keys[n] = x ;                                   \
+      if (with_counts)                                \
+      {                                               \
+        counts[n-1] += 1 - is_new ;                   \
+        counts[n] = 1 ;                               \
+      }                                               \
+      n = n + is_new ;                                \
+    } while (0)
+
+  while (i < na && j < nb)
+  {
+    take_a = A[i] <= B[j] ;
+    EMIT (take_a ? A[i] : B[j]) ;
+    i = i + take_a ;
+    j = j + 1 - take_a ;
+  }
+  for (; i < na; i++)
+    EMIT (A[i]) ;
+  for (; j < nb; j++)
+    EMIT (B[j]) ;
+
+  #undef EMIT
+
+  return n ;
+}
+
+static uint64_t sort_distinct (uint64_t *T, const uint64_t size, uint64_t *counts)
+{
+  const uint64_t mid = size / 2 ;
+  const int nth = omp_get_max_threads () ;
+  const int parallel = size > tuning.sequential_cutoff ;
+  uint64_t *keys, *tally, *first, *nb, *offset ;
+  uint64_t total = 0 ;
+
+  // Few distinct keys: the sorted histogram is the result, T is not
+  // even sorted (small arrays do not pay for the tables)
+  if (parallel)
+  {
+    total = histogram_count (T, size, counts) ;
+    if (total > 0)
+      return total ;
+  }
+
+  keys = (uint64_t *) arena_alloc (size * sizeof(uint64_t)) ;
+  tally = (counts != NULL) ? (uint64_t *) arena_alloc (size * sizeof(uint64_t)) : NULL ;
+  first = (uint64_t *) malloc (3 * nth * sizeof(uint64_t)) ;
+  nb = first + nth ;
+  offset = first + 2 * nth ;
+
+  // Everything but the last merge
+  if (parallel)
+  {
+    parallel_quicksort (T, mid) ;
+    parallel_quicksort (T + mid, size - mid) ;
+  }
+  else
+  {
+    sequential_quicksort (T, mid) ;
+    sequential_quicksort (T + mid, size - mid) ;
+  }
+
+  #pragma omp parallel num_threads(nth) if (parallel)
+  {
+    uint64_t team = omp_get_num_threads () ;
+    uint64_t tid = omp_get_thread_num () ;
+    uint64_t k0 = size * tid / team ;
+    uint64_t k1 = size * (tid + 1) / team ;
+    uint64_t i0 = merge_co_rank (k0, T, mid, T + mid, size - mid) ;
+    uint64_t i1 = merge_co_rank (k1, T, mid, T + mid, size - mid) ;
+
+    TRACE_BEGIN(t);
+    first[tid] = k0 ;
+    if (tally != NULL)
+      nb[tid] = merge_distinct (keys + k0, tally + k0, T + i0, i1 - i0,
+                                T + mid + (k0 - i0), (k1 - i1) - (k0 - i0), 1) ;
+    else
+      nb[tid] = merge_distinct (keys + k0, NULL, T + i0, i1 - i0,
+                                T + mid + (k0 - i0), (k1 - i1) - (k0 - i0), 0) ;
+    TRACE_END(t, "merge distinct", k1 - k0);
+
+    #pragma omp barrier
+    #pragma omp single
+    {
+      // A piece starting with the last key of the previous non empty
+      // piece continues its run
+      uint64_t p, last = team ;
+
+      for (p = 0; p < team; p++)
+      {
+        if (nb[p] > 0 && last < team && keys[first[last] + nb[last] - 1] == keys[first[p]])
+        {
+          if (tally != NULL)
+            tally[first[last] + nb[last] - 1] += tally[first[p]] ;
+          first[p] = first[p] + 1 ;
+          nb[p] = nb[p] - 1 ;
+        }
+        if (nb[p] > 0)
+          last = p ;
+        offset[p] = total ;
+        total = total + nb[p] ;
+      }
+    }
+
+    memcpy (T + offset[tid], keys + first[tid], nb[tid] * sizeof(uint64_t)) ;
+    if (tally != NULL)
+      memcpy (counts + offset[tid], tally + first[tid], nb[tid] * sizeof(uint64_t)) ;
+  }
+
+  free (first) ;
+  if (tally != NULL)
+    arena_release (tally) ;
+  arena_release (keys) ;
+
+  return total ;
+}
+
+uint64_t parallel_sort_unique (uint64_t *T, const uint64_t size)
+{
+  return sort_distinct (T, size, NULL) ;
+}
+
+uint64_t parallel_sort_count (uint64_t *T, const uint64_t size, uint64_t *counts)
+{
+  return sort_distinct (T, size, counts) ;
+}
@@ -1,7 +1,17 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <omp.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+
+#include <x86intrin.h>
 
 #include "sorting.h"
 
@@ -20,6 +30,139 @@ uint64_t average_time (void)
     return s / NBEXPERIMENTS ;
 }
 
+uint64_t time_experiments (const char *label, const experiment_t *e)
+{
+    uint64_t start, end ;
+    unsigned int exp ;
+    const char *error ;
+
+    for (exp = 0 ; exp < NBEXPERIMENTS; exp++)
+    {
+        if (e->prepare != NULL)
+            e->prepare (e->arg, exp) ;
+
+        start = _rdtsc () ;
+
+        e->run (e->arg) ;
+
+        end = _rdtsc () ;
+        experiments [exp] = end - start ;
+
+        error = (e->verify != NULL) ? e->verify (e->arg, exp) : NULL ;
+        if (error != NULL)
+        {
+            fprintf (stderr, "ERROR: %s %s\n", label, error) ;
+            exit (-1) ;
+        }
+    }
+
+    return average_time () ;
+}
+
+double run_experiments (const char *label, const experiment_t *e)
+{
+    double cycles = (double)time_experiments (label, e)/1000000 ;
+
+    printf (" %-32s %10.2lf Mcycles\n", label, cycles) ;
+    return cycles ;
+}
+
+/* the experiment of time_sort_experiments */
+typedef struct
+{
+    sort_t sort ;
+    uint64_t *T ;
+    uint64_t size ;
+    init_t init ;
+    const void *arg ;
+    uint64_t fingerprint ;
+} sort_experiment_t ;
+
+static void prepare_sort (void *arg, const unsigned int exp)
+{
+    sort_experiment_t *s = (sort_experiment_t *) arg ;
+
+    s->init (s->T, s->size, exp, s->arg) ;
+    s->fingerprint = multiset_fingerprint (s->T, s->size) ;
+}
+
+static void run_sort (void *arg)
+{
+    sort_experiment_t *s = (sort_experiment_t *) arg ;
+
+    s->sort (s->T, s->size) ;
+}
+
+static const char *verify_sort (void *arg, const unsigned int exp)
+{
+    sort_experiment_t *s = (sort_experiment_t *) arg ;
+
+    if (! is_sorted (s->T, s->size))
+        return "did not sort the array" ;
+    if (multiset_fingerprint (s->T, s->size) != s->fingerprint)
+        return "lost or duplicated elements" ;
+    return NULL ;
+}
+
+uint64_t time_sort_experiments (const char *label, sort_t sort, uint64_t *T, const uint64_t size,
+                                init_t init, const void *arg)
+{
+    sort_experiment_t s = { sort, T, size, init, arg, 0 } ;
+    experiment_t e = { &s, prepare_sort, run_sort, verify_sort } ;
+
+    return time_experiments (label, &e) ;
+}
+
+double run_sort_experiments (const char *label, sort_t sort, uint64_t *T, const uint64_t size,
+                             init_t init, const void *arg)
+{
+    sort_experiment_t s = { sort, T, size, init, arg, 0 } ;
+    experiment_t e = { &s, prepare_sort, run_sort, verify_sort } ;
+
+    return run_experiments (label, &e) ;
+}
+
+int select_kernel (const char *env_name, const kernel_choice_t *kernels, const int nb_kernels,
+                   const int warn)
+{
+    const char *env = getenv (env_name) ;
+    int k, fastest = 0, asked = -1 ;
+
+    for (k = 0; k < nb_kernels; k++)
+    {
+        if (kernels[k].supported)
+            fastest = k ;
+        if (env != NULL && strcmp (env, kernels[k].name) == 0)
+            asked = k ;
+    }
+
+    if (env == NULL || (asked >= 0 && kernels[asked].supported))
+        return (env == NULL) ? fastest : asked ;
+
+    // Say so when the kernel asked for is not the one the timings use
+    if (warn && asked < 0)
+    {
+        fprintf (stderr, "WARNING: unknown %s=%s (", env_name, env) ;
+        for (k = 0; k < nb_kernels; k++)
+            fprintf (stderr, "%s%s", (k > 0) ? ", " : "", kernels[k].name) ;
+        fprintf (stderr, "), using %s\n", kernels[fastest].name) ;
+    }
+    else if (warn)
+        fprintf (stderr, "WARNING: %s=%s is not supported by this CPU, using %s\n",
+                 env_name, env, kernels[fastest].name) ;
+
+    return fastest ;
+}
+
+void init_array_benchmark (uint64_t *T, const uint64_t size, const unsigned int exp, const void *arg)
+{
+    #ifdef RINIT
+        init_array_random (T, size) ;
+    #else
+        init_array_sequence (T, size) ;
+    #endif
+}
+
 
 void init_array_sequence (uint64_t *T, uint64_t size)
 {
@@ -56,46 +199,309 @@ void print_array (uint64_t *T, uint64_t size)
     printf ("\n") ;
 }
 
-/* test if the array is sorted assuming that the elements to be sorted
- * is a sequence of consecutive values */
-int is_sorted_sequence (uint64_t *T, uint64_t size)
+/*
+   Verification routines. The array is split in contiguous blocks scanned
+   in parallel by SIMD kernels cloned for AVX-512, AVX2 and baseline x86-64
+   (the best clone is picked by the loader). Threads stop as soon as one
+   block fails.
+*/
+
+#define VERIFY_CLONES __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+
+/* number of elements scanned between two checks of the failure flag */
+#define VERIFY_BLOCK (1 << 14)
+
+/* below this size the verification stays sequential */
+#define VERIFY_PARALLEL_CUTOFF (1 << 16)
+
+typedef uint64_t (*block_check_t) (const uint64_t *, const uint64_t *, uint64_t, uint64_t);
+
+VERIFY_CLONES
+static uint64_t block_gaps (const uint64_t *T, const uint64_t *unused, uint64_t from, uint64_t to)
 {
-    uint64_t i ;
-  
-    for (i = 1 ; i < size ; i++)
+    uint64_t i, bad = 0 ;
+
+    #pragma omp simd reduction(|:bad)
+    for (i = from ; i < to ; i++)
     {
-        /* test designed specifically for our usecase */
-        if (T[i-1] +1  != T [i] )
-            return 0 ;
+        bad |= (T[i-1] + 1 != T[i]) ;
     }
-    return 1 ;
+    return bad ;
 }
 
-/* test if the array is sorted */
-int is_sorted (uint64_t *T, uint64_t size)
+VERIFY_CLONES
+static uint64_t block_descents (const uint64_t *T, const uint64_t *unused, uint64_t from, uint64_t to)
 {
-    uint64_t i ;
-  
-    for (i = 1 ; i < size ; i++)
+    uint64_t i, bad = 0 ;
+
+    #pragma omp simd reduction(|:bad)
+    for (i = from ; i < to ; i++)
+    {
+        bad |= (T[i-1] > T[i]) ;
+    }
+    return bad ;
+}
+
+VERIFY_CLONES
+static uint64_t block_differences (const uint64_t *T1, const uint64_t *T2, uint64_t from, uint64_t to)
+{
+    uint64_t i, bad = 0 ;
+
+    #pragma omp simd reduction(|:bad)
+    for (i = from ; i < to ; i++)
+    {
+        bad |= T1[i] ^ T2[i] ;
+    }
+    return bad ;
+}
+
+/* returns 1 if check() reports nothing on any block of [from, to) */
+static int parallel_check (block_check_t check, const uint64_t *T1, const uint64_t *T2,
+                           uint64_t from, uint64_t to)
+{
+    int failed = 0 ;
+
+    if (to <= from)
+        return 1 ;
+
+    #pragma omp parallel if (to - from > VERIFY_PARALLEL_CUTOFF)
     {
-        if (T[i-1] > T [i] ){
-            return 0 ;
+        uint64_t nth = omp_get_num_threads () ;
+        uint64_t tid = omp_get_thread_num () ;
+        uint64_t lo = from + (to - from) * tid / nth ;
+        uint64_t hi = from + (to - from) * (tid + 1) / nth ;
+        uint64_t b, e ;
+        int stop ;
+
+        for (b = lo ; b < hi ; b = e)
+        {
+            e = (hi - b > VERIFY_BLOCK) ? b + VERIFY_BLOCK : hi ;
+            if (check (T1, T2, b, e))
+            {
+                #pragma omp atomic write
+                failed = 1 ;
+            }
+            #pragma omp atomic read
+            stop = failed ;
+            if (stop)
+                break ;
         }
     }
-    return 1 ;
+    return ! failed ;
+}
+
+/* test if the array is sorted assuming that the elements to be sorted
+ * is a sequence of consecutive values */
+int is_sorted_sequence (uint64_t *T, uint64_t size)
+{
+    /* test designed specifically for our usecase */
+    return parallel_check (block_gaps, T, NULL, 1, size) ;
+}
+
+/* test if the array is sorted */
+int is_sorted (uint64_t *T, uint64_t size)
+{
+    return parallel_check (block_descents, T, NULL, 1, size) ;
 }
 
 /* test if T1 and T2 are equal */
 int are_vector_equals (uint64_t *T1, uint64_t *T2, uint64_t size)
 {
-    uint64_t i ;
-  
-    for (i = 0 ; i < size ; i++)
+    return parallel_check (block_differences, T1, T2, 0, size) ;
+}
+
+VERIFY_CLONES
+static uint64_t block_fingerprint (const uint64_t *T, uint64_t from, uint64_t to)
+{
+    uint64_t i, z, sum = 0 ;
+
+    /* splitmix64 finalizer: every bit of the key affects every bit of
+       the hash, so lost or duplicated keys change the sum */
+    #pragma omp simd reduction(+:sum)
+    for (i = from ; i < to ; i++)
     {
-        if (T1[i] != T2 [i] ){
-            return 0 ;
-        }
+        z = T[i] + 0x9e3779b97f4a7c15ULL ;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL ;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL ;
+        sum += z ^ (z >> 31) ;
     }
-    return 1 ;
-    
+    return sum ;
+}
+
+/* order independent hash of the multiset of values stored in T */
+uint64_t multiset_fingerprint (uint64_t *T, uint64_t size)
+{
+    uint64_t sum = 0 ;
+
+    #pragma omp parallel reduction(+:sum) if (size > VERIFY_PARALLEL_CUTOFF)
+    {
+        uint64_t nth = omp_get_num_threads () ;
+        uint64_t tid = omp_get_thread_num () ;
+
+        sum += block_fingerprint (T, size * tid / nth, size * (tid + 1) / nth) ;
+    }
+    return sum ;
+}
+
+long peak_memory_kb (void)
+{
+    struct rusage usage ;
+
+    getrusage (RUSAGE_SELF, &usage) ;
+
+    /* on Linux ru_maxrss is already expressed in KiB */
+    return usage.ru_maxrss ;
+}
+
+/* data TLB read misses of this thread and of the threads it creates
+ * afterwards, -1 when perf events are not available (container, paranoid
+ * setting) */
+static int dtlb_fd = -2 ;
+
+static uint64_t dtlb_misses (void)
+{
+    struct perf_event_attr attr ;
+    uint64_t count ;
+
+    if (dtlb_fd == -2)
+    {
+        memset (&attr, 0, sizeof(attr)) ;
+        attr.size = sizeof(attr) ;
+        attr.type = PERF_TYPE_HW_CACHE ;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB
+                      | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                      | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) ;
+        attr.inherit = 1 ;
+        attr.exclude_kernel = 1 ;
+        attr.exclude_hv = 1 ;
+        dtlb_fd = syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0) ;
+    }
+
+    if (dtlb_fd < 0 || read (dtlb_fd, &count, sizeof(count)) != sizeof(count))
+        return UINT64_MAX ;
+    return count ;
+}
+
+/* peak resident set size since the last reset_peak_rss(), in KiB. Only
+ * raw system calls here: stdio would allocate inside the measured
+ * section */
+static int peak_reset_failed ;
+
+static void reset_peak_rss (void)
+{
+    int fd = open ("/proc/self/clear_refs", O_WRONLY) ;
+
+    /* without it (old kernel) VmHWM is the peak of the whole process */
+    if (fd < 0)
+        peak_reset_failed = 1 ;
+    else
+    {
+        if (write (fd, "5", 1) != 1)
+            peak_reset_failed = 1 ;
+        close (fd) ;
+    }
+}
+
+static long peak_rss_kb (void)
+{
+    char buf [4096] ;
+    char *line ;
+    ssize_t n = -1 ;
+    int fd = open ("/proc/self/status", O_RDONLY) ;
+
+    if (fd >= 0)
+    {
+        n = read (fd, buf, sizeof(buf) - 1) ;
+        close (fd) ;
+    }
+    if (n > 0)
+    {
+        buf[n] = '\0' ;
+        line = strstr (buf, "VmHWM:") ;
+        if (line != NULL)
+            return strtol (line + 6, NULL, 10) ;
+    }
+
+    /* no procfs: peak of the whole process */
+    return peak_memory_kb () ;
+}
+
+static void read_counters (mem_counters_t *c)
+{
+    struct rusage usage ;
+    arena_stats_t a = arena_stats () ;
+
+    getrusage (RUSAGE_SELF, &usage) ;
+    c->page_faults = usage.ru_minflt + usage.ru_majflt ;
+    c->dtlb_misses = dtlb_misses () ;
+
+    /* heap allocations and new arena mappings */
+    alloc_counters (&c->allocations, &c->allocated_bytes) ;
+    c->allocations += a.mappings ;
+    c->allocated_bytes += a.mapped_bytes ;
+}
+
+void mem_counters_start (mem_counters_t *c)
+{
+    const char *trim = getenv ("MEM_PEAK_TRIM") ;
+
+    /* the arena keeps the buffers of the previous variants for reuse, and
+     * they count in the peak; MEM_PEAK_TRIM=1 unmaps them first, for the
+     * peak of the variant alone (but its buffers are mapped again) */
+    if (trim != NULL && atoi (trim) > 0)
+        arena_trim () ;
+    reset_peak_rss () ;
+    read_counters (c) ;
+    c->peak_rss_kb = 0 ;
+}
+
+void mem_counters_stop (mem_counters_t *c)
+{
+    mem_counters_t now ;
+
+    read_counters (&now) ;
+    c->page_faults = now.page_faults - c->page_faults ;
+    c->dtlb_misses = (now.dtlb_misses == UINT64_MAX) ? UINT64_MAX
+                                                     : now.dtlb_misses - c->dtlb_misses ;
+    c->allocations = now.allocations - c->allocations ;
+    c->allocated_bytes = now.allocated_bytes - c->allocated_bytes ;
+    c->peak_rss_kb = peak_rss_kb () ;
+}
+
+void print_mem_counters (const char *label, mem_counters_t *c)
+{
+    arena_stats_t a = arena_stats () ;
+
+    printf (" %s allocations \t%lu (%.2lf MiB)\n", label, c->allocations,
+            (double)c->allocated_bytes/(1024*1024)) ;
+    printf (" %s peak RSS \t%.2lf MiB%s\n", label, (double)c->peak_rss_kb/1024,
+            peak_reset_failed ? " (whole process)" : "") ;
+    printf (" %s page faults \t%lu\n", label, c->page_faults) ;
+    if (c->dtlb_misses == UINT64_MAX)
+        printf (" %s dTLB misses \tn/a\n", label) ;
+    else
+        printf (" %s dTLB misses \t%lu\n", label, c->dtlb_misses) ;
+    printf (" arena: %lu mappings, %lu reuses, %.2lf MiB mapped (%.2lf MiB huge pages)\n\n",
+            a.mappings, a.reuses, (double)a.mapped_bytes/(1024*1024), (double)a.huge_bytes/(1024*1024)) ;
+}
+
+void write_mem_counters_csv (const char *program, const char *variant, const uint64_t size,
+                             const uint64_t cycles, mem_counters_t *c)
+{
+    FILE *f = fopen (MEM_COUNTERS_CSV, "a") ;
+
+    if (f == NULL)
+        return ;
+
+    if (ftell (f) == 0)
+        fprintf (f, "program,variant,size,threads,mcycles,allocations,allocated_bytes,"
+                    "peak_rss_kb,page_faults,dtlb_misses\n") ;
+
+    fprintf (f, "%s,%s,%lu,%d,%.2lf,%lu,%lu,%lu,%lu,", program, variant, size, omp_get_max_threads (),
+             (double)cycles/1000000, c->allocations, c->allocated_bytes, c->peak_rss_kb, c->page_faults) ;
+    if (c->dtlb_misses == UINT64_MAX)
+        fprintf (f, "\n") ;
+    else
+        fprintf (f, "%lu\n", c->dtlb_misses) ;
+    fclose (f) ;
 }